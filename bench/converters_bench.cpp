@@ -0,0 +1,168 @@
+// Micro-benchmarks of the protobuf <-> ROS converters and encoders.
+//
+// Runs without a socket or an rclcpp context. Every benchmark reports
+// allocs_per_op next to the time per op, counted by the global operator new
+// replaced below, so a regression on the allocation free hot path shows up
+// as a non zero counter.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+#include "../src/converters.hpp"
+#include "../src/encoders.hpp"
+#include "../src/proto/rx_arena.hpp"
+
+static std::atomic<uint64_t> allocations { 0 };
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// counts allocations made inside the timed loop only
+class AllocationCounter {
+public:
+    AllocationCounter()
+        : start_(allocations.load(std::memory_order_relaxed))
+    {
+    }
+
+    void report(benchmark::State& state) const
+    {
+        state.counters["allocs_per_op"] = benchmark::Counter(
+            (double)(allocations.load(std::memory_order_relaxed) - start_),
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    uint64_t start_;
+};
+
+static synapse::msgs::Status make_status()
+{
+    synapse::msgs::Status msg;
+    msg.mutable_header()->set_frame_id("base_link");
+    msg.mutable_header()->mutable_stamp()->set_sec(1700000000);
+    msg.mutable_header()->mutable_stamp()->set_nanosec(999999999);
+    msg.set_arming(1);
+    msg.set_mode(2);
+    msg.set_fuel_percentage(87);
+    msg.set_power(12);
+    msg.set_status_message("armed, manual mode");
+    msg.set_request_seq(42);
+    return msg;
+}
+
+static void BM_ComputeHeader(benchmark::State& state)
+{
+    synapse::msgs::Status status = make_status();
+    // a drifting estimate, so the translation takes the full int64 path
+    ConvertContext ctx {};
+    for (int64_t i = 0; i < 2 * ClockSync::window_size; ++i) {
+        int64_t remote = i * ns_per_sec;
+        ctx.clock.add_sample(remote, remote + 3500000000 + i * 20000);
+    }
+    std_msgs::msg::Header ros_header;
+
+    AllocationCounter counter;
+    for (auto _ : state) {
+        compute_header(status.header(), ros_header, ctx);
+        benchmark::DoNotOptimize(ros_header);
+    }
+    counter.report(state);
+}
+BENCHMARK(BM_ComputeHeader);
+
+// the copy done by the status handler, decoded message already at hand
+static void BM_StatusToRos(benchmark::State& state)
+{
+    synapse::msgs::Status status = make_status();
+    ConvertContext ctx {};
+    synapse_msgs::msg::Status ros_msg;
+
+    AllocationCounter counter;
+    for (auto _ : state) {
+        status_to_ros(status, ros_msg, ctx);
+        benchmark::DoNotOptimize(ros_msg);
+    }
+    counter.report(state);
+}
+BENCHMARK(BM_StatusToRos);
+
+// the full status handler without the publish: arena parse, convert, reset
+static void BM_StatusDecode(benchmark::State& state)
+{
+    std::string frame = make_status().SerializeAsString();
+    ConvertContext ctx {};
+    synapse_msgs::msg::Status ros_msg;
+
+    AllocationCounter counter;
+    for (auto _ : state) {
+        auto* msg = google::protobuf::Arena::CreateMessage<synapse::msgs::Status>(&rx_arena());
+        msg->ParseFromArray(frame.data(), frame.size());
+        status_to_ros(*msg, ros_msg, ctx);
+        benchmark::DoNotOptimize(ros_msg);
+        reset_rx_arena();
+    }
+    counter.report(state);
+}
+BENCHMARK(BM_StatusDecode);
+
+static void BM_JoyEncode(benchmark::State& state)
+{
+    sensor_msgs::msg::Joy msg;
+    msg.axes.assign(state.range(0), 0.25f);
+    msg.buttons.assign(state.range(1), 1);
+    JoyEncoder encoder;
+    uint8_t buf[1024];
+
+    AllocationCounter counter;
+    for (auto _ : state) {
+        int len = encoder.encode(msg, buf, sizeof(buf));
+        benchmark::DoNotOptimize(len);
+        benchmark::ClobberMemory();
+    }
+    counter.report(state);
+}
+BENCHMARK(BM_JoyEncode)->Args({ 8, 12 })->Args({ 32, 32 });
+
+static void BM_RoadCurveAngleEncode(benchmark::State& state)
+{
+    synapse_msgs::msg::RoadCurveAngle msg;
+    msg.header.frame_id = "base_link";
+    msg.header.stamp.sec = 1700000000;
+    msg.header.stamp.nanosec = 123456789;
+    msg.angle = 0.1;
+    RoadCurveAngleEncoder encoder;
+    uint8_t buf[1024];
+
+    AllocationCounter counter;
+    for (auto _ : state) {
+        int len = encoder.encode(msg, buf, sizeof(buf));
+        benchmark::DoNotOptimize(len);
+        benchmark::ClobberMemory();
+    }
+    counter.report(state);
+}
+BENCHMARK(BM_RoadCurveAngleEncode);
+
+BENCHMARK_MAIN();
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,592 @@
+// End to end benchmark of the bridge against a simulated cerebri.
+//
+// The bridge node runs in process, talking UDP over loopback to a fake
+// cerebri that speaks TinyFrame + protobuf. Outbound topics (joy,
+// road_curve_angle) are reflected by the fake as a status frame carrying the
+// send stamp, which gives the ROS -> cerebri -> ROS round trip. The status
+// topic is streamed by the fake with its own stamp, which gives the one way
+// cerebri -> ROS latency. Results are printed as one JSON document.
+//
+//   synapse_ros_bench [--topics joy,road_curve_angle,status] [--rates 100,1000,0]
+//                     [--payloads 8,64,512] [--duration 2.0] [--output file]
+//                     [--low-latency] [--rx-workers N] [--rx-batch N]
+//                     [--tx-batch-window-us N] [--codec] [--port N]
+//
+// A rate of 0 sends as fast as the publisher allows. --codec negotiates the
+// payload encoding for the three topics, the fake encodes and decodes them
+// too, wire_bytes_per_s counts the UDP payload both ways, so a run with and
+// one without gives the bandwidth the codec saves.
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <sensor_msgs/msg/joy.hpp>
+#include <synapse_msgs/msg/road_curve_angle.hpp>
+#include <synapse_msgs/msg/status.hpp>
+
+#include <synapse_protobuf/joy.pb.h>
+#include <synapse_protobuf/road_curve_angle.pb.h>
+#include <synapse_protobuf/status.pb.h>
+#include <synapse_protobuf/time.pb.h>
+#include <synapse_tinyframe/SynapseTopics.h>
+#include <synapse_tinyframe/TinyFrame.h>
+
+#include "../src/proto/frame_codec.hpp"
+#include "../src/proto/latency.hpp"
+#include "../src/synapse_ros.hpp"
+
+using boost::asio::ip::udp;
+
+// which stream a status frame belongs to, carried in Status.mode
+enum class Source : int32_t {
+    Joy = 1,
+    RoadCurveAngle = 2,
+    Status = 3,
+};
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void split_stamp(int64_t ns, int32_t& sec, uint32_t& nanosec)
+{
+    sec = (int32_t)(ns / 1000000000);
+    nanosec = (uint32_t)(ns % 1000000000);
+}
+
+static int64_t join_stamp(int64_t sec, int64_t nanosec)
+{
+    return sec * 1000000000 + nanosec;
+}
+
+// Simulated cerebri, one TinyFrame instance served by its own io thread.
+class FakeCerebri {
+public:
+    static constexpr int codec_control_topic = 250;
+
+    FakeCerebri(int port, int bridge_port, const std::vector<int64_t>& codec_topics)
+        : sock_(io_context_, udp::endpoint(boost::asio::ip::address_v4::loopback(), port))
+        , bridge_(boost::asio::ip::address_v4::loopback(), bridge_port)
+        , codec_(codec_control_topic, codec_topics, 16)
+    {
+        tf_ = TF_Init(TF_SLAVE, FakeCerebri::write_tf);
+        tf_->userdata = this;
+        TF_AddTypeListener(tf_, SYNAPSE_JOY_TOPIC, FakeCerebri::joy_listener);
+        TF_AddTypeListener(tf_, SYNAPSE_ROAD_CURVE_ANGLE_TOPIC, FakeCerebri::road_curve_angle_listener);
+        TF_AddTypeListener(tf_, SYNAPSE_UPTIME_TOPIC, FakeCerebri::time_sync_listener);
+        if (!codec_topics.empty()) {
+            TF_AddTypeListener(tf_, codec_control_topic, FakeCerebri::codec_listener);
+        }
+        rx_start();
+        thread_ = std::thread([this]() { io_context_.run(); });
+    }
+
+    ~FakeCerebri()
+    {
+        io_context_.stop();
+        thread_.join();
+    }
+
+    // stream status frames at rate (0 = flat out) with a payload_len long
+    // status_message, until stream_stop()
+    void stream_start(double rate, std::size_t payload_len)
+    {
+        boost::asio::post(io_context_, [this, rate, payload_len]() {
+            streaming_ = true;
+            stream_period_ = rate > 0 ? std::chrono::nanoseconds((int64_t)(1e9 / rate)) : std::chrono::nanoseconds(0);
+            stream_payload_.assign(payload_len, 'x');
+            stream_next_ = std::chrono::steady_clock::now();
+            stream_tick();
+        });
+    }
+
+    void stream_stop()
+    {
+        boost::asio::post(io_context_, [this]() { streaming_ = false; });
+    }
+
+    uint64_t sent() const { return sent_.load(std::memory_order_relaxed); }
+    // udp payload bytes sent and received
+    uint64_t wire_bytes() const { return wire_bytes_.load(std::memory_order_relaxed); }
+
+private:
+    static void write_tf(TinyFrame* tf, const uint8_t* buf, uint32_t len)
+    {
+        FakeCerebri* self = (FakeCerebri*)tf->userdata;
+        self->tx_buf_.insert(self->tx_buf_.end(), buf, buf + len);
+    }
+
+    // the offer lists the topics the bridge encodes, answer with all of them
+    static TF_Result codec_listener(TinyFrame* tf, TF_Msg* msg)
+    {
+        FakeCerebri* self = (FakeCerebri*)tf->userdata;
+        if (self->codec_.accept(msg->data, msg->len, now_ns())) {
+            self->tx_buf_.clear();
+            TF_Send(tf, msg);
+            self->flush();
+        }
+        return TF_STAY;
+    }
+
+    // the plain payload of msg, false if it could not be decoded
+    bool payload(TF_Msg* msg, const uint8_t*& data, uint32_t& len)
+    {
+        data = msg->data;
+        len = msg->len;
+        if (!codec_.active(msg->type, now_ns())) {
+            return true;
+        }
+        int decoded = codec_.decode(msg->type, msg->data, msg->len, codec_rx_buf_, sizeof(codec_rx_buf_));
+        if (decoded < 0) {
+            return false;
+        }
+        data = codec_rx_buf_;
+        len = decoded;
+        return true;
+    }
+
+    static TF_Result joy_listener(TinyFrame* tf, TF_Msg* msg)
+    {
+        FakeCerebri* self = (FakeCerebri*)tf->userdata;
+        const uint8_t* data;
+        uint32_t len;
+        synapse::msgs::Joy joy;
+        if (self->payload(msg, data, len) && joy.ParseFromArray(data, len) && joy.buttons_size() >= 2) {
+            int64_t stamp = ((int64_t)(uint32_t)joy.buttons(0) << 32) | (uint32_t)joy.buttons(1);
+            self->send_status(Source::Joy, stamp, "");
+        }
+        return TF_STAY;
+    }
+
+    static TF_Result road_curve_angle_listener(TinyFrame* tf, TF_Msg* msg)
+    {
+        FakeCerebri* self = (FakeCerebri*)tf->userdata;
+        const uint8_t* data;
+        uint32_t len;
+        synapse::msgs::RoadCurveAngle road_curve_angle;
+        if (self->payload(msg, data, len) && road_curve_angle.ParseFromArray(data, len)) {
+            const auto& stamp = road_curve_angle.header().stamp();
+            self->send_status(Source::RoadCurveAngle, join_stamp(stamp.sec(), stamp.nanosec()), "");
+        }
+        return TF_STAY;
+    }
+
+    // answer time sync pings with our uptime, under the ping's frame id
+    static TF_Result time_sync_listener(TinyFrame* tf, TF_Msg* msg)
+    {
+        FakeCerebri* self = (FakeCerebri*)tf->userdata;
+        int32_t sec;
+        uint32_t nanosec;
+        split_stamp(now_ns(), sec, nanosec);
+        synapse::msgs::Time uptime;
+        uptime.set_sec(sec);
+        uptime.set_nanosec(nanosec);
+        std::string buf = uptime.SerializeAsString();
+
+        msg->data = (const uint8_t*)buf.data();
+        msg->len = buf.size();
+        self->tx_buf_.clear();
+        TF_Respond(tf, msg);
+        self->flush();
+        return TF_STAY;
+    }
+
+    bool flush()
+    {
+        // a blocking send keeps the stream honest, loopback never stalls long
+        boost::system::error_code ec;
+        sock_.send_to(boost::asio::buffer(tx_buf_), bridge_, 0, ec);
+        if (!ec) {
+            wire_bytes_.fetch_add(tx_buf_.size(), std::memory_order_relaxed);
+        }
+        return !ec;
+    }
+
+    void send_status(Source source, int64_t stamp_ns, const std::string& payload)
+    {
+        int32_t sec;
+        uint32_t nanosec;
+        split_stamp(stamp_ns, sec, nanosec);
+        status_.set_mode((int32_t)source);
+        status_.mutable_header()->mutable_stamp()->set_sec(sec);
+        status_.mutable_header()->mutable_stamp()->set_nanosec(nanosec);
+        status_.set_status_message(payload);
+        status_.SerializeToString(&status_buf_);
+
+        TF_Msg msg;
+        TF_ClearMsg(&msg);
+        msg.type = SYNAPSE_STATUS_TOPIC;
+        msg.data = (const uint8_t*)status_buf_.data();
+        msg.len = status_buf_.size();
+        if (codec_.active(SYNAPSE_STATUS_TOPIC, now_ns()) && msg.len <= sizeof(codec_tx_buf_) - FrameCodec::header_length) {
+            msg.len = codec_.encode(SYNAPSE_STATUS_TOPIC, msg.data, msg.len, codec_tx_buf_, false);
+            msg.data = codec_tx_buf_;
+        }
+        tx_buf_.clear();
+        TF_Send(tf_, &msg);
+        if (flush()) {
+            sent_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void stream_tick()
+    {
+        if (!streaming_) {
+            return;
+        }
+        send_status(Source::Status, now_ns(), stream_payload_);
+        if (stream_period_.count() == 0) {
+            boost::asio::post(io_context_, [this]() { stream_tick(); });
+            return;
+        }
+        stream_next_ += stream_period_;
+        stream_timer_.expires_at(stream_next_);
+        stream_timer_.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec) {
+                stream_tick();
+            }
+        });
+    }
+
+    void rx_start()
+    {
+        sock_.async_receive_from(boost::asio::buffer(rx_buf_), rx_endpoint_,
+            [this](const boost::system::error_code& ec, std::size_t len) {
+                if (!ec) {
+                    wire_bytes_.fetch_add(len, std::memory_order_relaxed);
+                    TF_Accept(tf_, rx_buf_, len);
+                }
+                rx_start();
+            });
+    }
+
+    boost::asio::io_context io_context_ {};
+    udp::socket sock_;
+    udp::endpoint bridge_;
+    udp::endpoint rx_endpoint_ {};
+    uint8_t rx_buf_[65536];
+    std::vector<uint8_t> tx_buf_ {};
+    TinyFrame* tf_ { NULL };
+    synapse::msgs::Status status_ {};
+    std::string status_buf_ {};
+    std::atomic<uint64_t> sent_ { 0 };
+    std::atomic<uint64_t> wire_bytes_ { 0 };
+
+    // payload encoding, io thread only
+    FrameCodec codec_;
+    uint8_t codec_rx_buf_[65536];
+    uint8_t codec_tx_buf_[65536];
+
+    bool streaming_ { false };
+    std::chrono::nanoseconds stream_period_ { 0 };
+    std::string stream_payload_ {};
+    std::chrono::steady_clock::time_point stream_next_ {};
+    boost::asio::steady_timer stream_timer_ { io_context_ };
+
+    std::thread thread_ {};
+};
+
+struct BenchOptions {
+    std::vector<std::string> topics { "joy", "road_curve_angle", "status" };
+    std::vector<double> rates { 100, 1000, 0 };
+    std::vector<std::size_t> payloads { 8, 64, 512 };
+    double duration { 2.0 };
+    std::string output {};
+    bool low_latency { false };
+    int rx_workers { 0 };
+    int rx_batch { 1 };
+    int tx_batch_window_us { 0 };
+    bool codec { false };
+    int port { 14242 };
+};
+
+struct BenchResult {
+    std::string topic;
+    double rate;
+    std::size_t payload;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t wire_bytes;
+    double duration_s;
+    LatencySummary latency;
+    double cpu_us_per_msg;
+};
+
+static double cpu_time_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// ROS side of the benchmark, publishes the outbound topics and collects the
+// status frames coming back through the bridge
+class BenchNode : public rclcpp::Node {
+public:
+    BenchNode()
+        : Node("synapse_ros_bench")
+    {
+        pub_joy_ = this->create_publisher<sensor_msgs::msg::Joy>("in/joy", 10);
+        pub_road_curve_angle_ = this->create_publisher<synapse_msgs::msg::RoadCurveAngle>("in/road_curve_angle", 10);
+        sub_status_ = this->create_subscription<synapse_msgs::msg::Status>("out/status", 10,
+            std::bind(&BenchNode::status_callback, this, std::placeholders::_1));
+    }
+
+    BenchResult run(FakeCerebri& fake, const std::string& topic, double rate, std::size_t payload, double duration)
+    {
+        Source source = topic == "joy" ? Source::Joy
+            : topic == "road_curve_angle"  ? Source::RoadCurveAngle
+                                           : Source::Status;
+        expected_ = (int32_t)source;
+        received_ = 0;
+        histogram_.drain();
+
+        uint64_t fake_sent = fake.sent();
+        uint64_t wire_bytes = fake.wire_bytes();
+        uint64_t sent = 0;
+        double cpu_start = cpu_time_us();
+        auto start = std::chrono::steady_clock::now();
+        auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(duration));
+
+        if (source == Source::Status) {
+            fake.stream_start(rate, payload);
+            std::this_thread::sleep_until(end);
+            fake.stream_stop();
+        } else {
+            auto period = rate > 0 ? std::chrono::nanoseconds((int64_t)(1e9 / rate)) : std::chrono::nanoseconds(0);
+            auto next = start;
+            while (std::chrono::steady_clock::now() < end) {
+                publish(source, payload);
+                ++sent;
+                if (period.count() > 0) {
+                    next += period;
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        // let frames in flight land, they still count to this run
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        double cpu_end = cpu_time_us();
+
+        BenchResult result {};
+        result.topic = topic;
+        result.rate = rate;
+        result.payload = payload;
+        result.sent = source == Source::Status ? fake.sent() - fake_sent : sent;
+        result.received = received_.load();
+        result.wire_bytes = fake.wire_bytes() - wire_bytes;
+        result.duration_s = std::chrono::duration<double>(stop - start).count();
+        result.latency = histogram_.drain();
+        result.cpu_us_per_msg = result.received > 0 ? (cpu_end - cpu_start) / result.received : 0;
+        expected_ = 0;
+        return result;
+    }
+
+private:
+    void publish(Source source, std::size_t payload)
+    {
+        int64_t stamp = now_ns();
+        if (source == Source::Joy) {
+            // the stamp travels in the first two buttons, the axes pad the
+            // message to roughly payload bytes
+            joy_.buttons.assign({ (int32_t)(uint32_t)(stamp >> 32), (int32_t)(uint32_t)stamp });
+            joy_.axes.assign(payload / sizeof(float), 0.5f);
+            pub_joy_->publish(joy_);
+        } else {
+            split_stamp(stamp, road_curve_angle_.header.stamp.sec, road_curve_angle_.header.stamp.nanosec);
+            road_curve_angle_.header.frame_id.assign(payload, 'x');
+            road_curve_angle_.angle = 0.1;
+            pub_road_curve_angle_->publish(road_curve_angle_);
+        }
+    }
+
+    void status_callback(const synapse_msgs::msg::Status& msg)
+    {
+        if (msg.mode != expected_) {
+            return;
+        }
+        histogram_.record(now_ns() - join_stamp(msg.header.stamp.sec, msg.header.stamp.nanosec));
+        received_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    rclcpp::Publisher<sensor_msgs::msg::Joy>::SharedPtr pub_joy_;
+    rclcpp::Publisher<synapse_msgs::msg::RoadCurveAngle>::SharedPtr pub_road_curve_angle_;
+    rclcpp::Subscription<synapse_msgs::msg::Status>::SharedPtr sub_status_;
+    sensor_msgs::msg::Joy joy_ {};
+    synapse_msgs::msg::RoadCurveAngle road_curve_angle_ {};
+
+    std::atomic<int32_t> expected_ { 0 };
+    std::atomic<uint64_t> received_ { 0 };
+    LatencyHistogram histogram_ {};
+};
+
+template <typename T, typename F>
+static std::vector<T> parse_list(const std::string& arg, F&& parse)
+{
+    std::vector<T> list;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            list.push_back(parse(item));
+        }
+    }
+    return list;
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            return i + 1 < argc ? argv[++i] : "";
+        };
+        if (arg == "--topics") {
+            options.topics = parse_list<std::string>(value(), [](const std::string& s) { return s; });
+        } else if (arg == "--rates") {
+            options.rates = parse_list<double>(value(), [](const std::string& s) { return std::stod(s); });
+        } else if (arg == "--payloads") {
+            options.payloads = parse_list<std::size_t>(value(), [](const std::string& s) { return std::stoul(s); });
+        } else if (arg == "--duration") {
+            options.duration = std::stod(value());
+        } else if (arg == "--output") {
+            options.output = value();
+        } else if (arg == "--low-latency") {
+            options.low_latency = true;
+        } else if (arg == "--rx-workers") {
+            options.rx_workers = std::stoi(value());
+        } else if (arg == "--rx-batch") {
+            options.rx_batch = std::stoi(value());
+        } else if (arg == "--tx-batch-window-us") {
+            options.tx_batch_window_us = std::stoi(value());
+        } else if (arg == "--codec") {
+            options.codec = true;
+        } else if (arg == "--port") {
+            options.port = std::stoi(value());
+        } else if (arg == "--ros-args") {
+            break;
+        } else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void write_json(std::ostream& out, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+    out << "{\n";
+    out << "  \"config\": {\"low_latency\": " << (options.low_latency ? "true" : "false")
+        << ", \"rx_workers\": " << options.rx_workers
+        << ", \"rx_batch\": " << options.rx_batch
+        << ", \"tx_batch_window_us\": " << options.tx_batch_window_us
+        << ", \"codec\": " << (options.codec ? "true" : "false")
+        << ", \"latency_stats\": " << (latency_stats_enabled ? "true" : "false") << "},\n";
+    out << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+            "    {\"topic\": \"%s\", \"rate_hz\": %g, \"payload_bytes\": %zu, \"sent\": %llu, "
+            "\"received\": %llu, \"throughput_msgs_per_s\": %.1f, \"wire_bytes_per_s\": %.1f, "
+            "\"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}, "
+            "\"cpu_us_per_msg\": %.2f}%s\n",
+            r.topic.c_str(), r.rate, r.payload, (unsigned long long)r.sent, (unsigned long long)r.received,
+            r.duration_s > 0 ? r.received / r.duration_s : 0.0,
+            r.duration_s > 0 ? r.wire_bytes / r.duration_s : 0.0, r.latency.mean_us, r.latency.p50_us,
+            r.latency.p99_us, r.latency.p999_us, r.latency.max_us, r.cpu_us_per_msg,
+            i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    rclcpp::init(argc, argv);
+
+    int fake_port = options.port;
+    int bridge_port = options.port + 1;
+    std::vector<int64_t> codec_topics;
+    if (options.codec) {
+        codec_topics = { SYNAPSE_JOY_TOPIC, SYNAPSE_ROAD_CURVE_ANGLE_TOPIC, SYNAPSE_STATUS_TOPIC };
+    }
+    FakeCerebri fake(fake_port, bridge_port, codec_topics);
+
+    rclcpp::NodeOptions bridge_options;
+    bridge_options.parameter_overrides({
+        { "host", "127.0.0.1" },
+        { "port", fake_port },
+        { "local_port", bridge_port },
+        // the fake's uptime is its steady clock, latencies are measured
+        // against the raw stamps
+        { "clock_sync", false },
+        // every publisher exists before the first run, none is created
+        // while frames are being counted
+        { "lazy_publishers", false },
+        { "low_latency", options.low_latency },
+        { "rx_workers", options.rx_workers },
+        { "rx_batch", options.rx_batch },
+        { "tx_batch_window_us", options.tx_batch_window_us },
+        { "codec_topics", codec_topics },
+        { "codec_control_topic", FakeCerebri::codec_control_topic },
+    });
+    auto bridge = std::make_shared<SynapseRos>(bridge_options);
+    auto bench = std::make_shared<BenchNode>();
+
+    rclcpp::executors::SingleThreadedExecutor executor;
+    executor.add_node(bridge);
+    executor.add_node(bench);
+    std::thread spin_thread([&executor]() { executor.spin(); });
+
+    // discovery between the two nodes of the process
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::vector<BenchResult> results;
+    for (const auto& topic : options.topics) {
+        for (double rate : options.rates) {
+            for (std::size_t payload : options.payloads) {
+                results.push_back(bench->run(fake, topic, rate, payload, options.duration));
+            }
+        }
+    }
+
+    executor.cancel();
+    spin_thread.join();
+    rclcpp::shutdown();
+
+    if (options.output.empty()) {
+        write_json(std::cout, options, results);
+    } else {
+        std::ofstream out(options.output);
+        write_json(out, options, results);
+    }
+    return 0;
+}
+
+// vi: ts=4 sw=4 et
@@ -3,14 +3,36 @@ from pathlib import Path
 
 from launch import LaunchDescription
 from launch.actions import DeclareLaunchArgument, Shutdown
-from launch.substitutions import LaunchConfiguration
-from launch_ros.actions import Node
+from launch.conditions import IfCondition, UnlessCondition
+from launch.substitutions import LaunchConfiguration, PythonExpression
+from launch_ros.actions import LoadComposableNodes, Node
+from launch_ros.descriptions import ComposableNode
 
 ARGUMENTS = [
+    DeclareLaunchArgument('transport', default_value='udp',
+                          choices=['udp', 'tcp', 'serial'],
+                          description='link transport to cerebri'),
     DeclareLaunchArgument('host', default_value='192.0.2.1',
                           description='port for cerebri'),
     DeclareLaunchArgument('port', default_value='4242',
                           description='tcp port for cerebri'),
+    DeclareLaunchArgument('device', default_value='/dev/ttyUSB0',
+                          description='serial device for cerebri'),
+    DeclareLaunchArgument('baud', default_value='921600',
+                          description='serial baud rate'),
+    DeclareLaunchArgument('tx_batch_window_us', default_value='0',
+                          description='coalesce tx frames within window, 0 disables'),
+    DeclareLaunchArgument('rx_batch', default_value='1',
+                          description='datagrams drained per rx wakeup'),
+    DeclareLaunchArgument('low_latency', default_value='false',
+                          choices=['true', 'false'],
+                          description='busy poll the link socket from a dedicated thread'),
+    DeclareLaunchArgument('busy_poll_cpu', default_value='-1',
+                          description='cpu the busy poll thread is pinned to, -1 disables'),
+    DeclareLaunchArgument('record_path', default_value='',
+                          description='capture link traffic to this file, replay with synapse_ros_replay'),
+    DeclareLaunchArgument('container', default_value='',
+                          description='load into this component container instead of a standalone process'),
     DeclareLaunchArgument('log_level', default_value='error',
                           choices=['info', 'warn', 'error'],
                           description='log level'),
@@ -25,27 +47,55 @@ def generate_launch_description():
     # Launch configurations
     host = LaunchConfiguration('host')
     port = LaunchConfiguration('port')
+    container = LaunchConfiguration('container')
+    use_container = PythonExpression(["'", container, "' != ''"])
+
+    parameters = [{
+        'transport': LaunchConfiguration('transport'),
+        'host': LaunchConfiguration('host'),
+        'port': LaunchConfiguration('port'),
+        'device': LaunchConfiguration('device'),
+        'baud': LaunchConfiguration('baud'),
+        'tx_batch_window_us': LaunchConfiguration('tx_batch_window_us'),
+        'rx_batch': LaunchConfiguration('rx_batch'),
+        'low_latency': LaunchConfiguration('low_latency'),
+        'busy_poll_cpu': LaunchConfiguration('busy_poll_cpu'),
+        'record_path': LaunchConfiguration('record_path'),
+        'use_sim_time': LaunchConfiguration('use_sim_time'),
+    }]
 
     synapse_ros = Node(
         #prefix='xterm -e gdb --args',
         namespace='cerebri',
         package='synapse_ros',
         executable='synapse_ros',
-        parameters=[{
-            'host': LaunchConfiguration('host'),
-            'port': LaunchConfiguration('port'),
-            'use_sim_time': LaunchConfiguration('use_sim_time'),
-        }],
+        parameters=parameters,
         output='screen',
         remappings=[
 
         ],
         arguments=['--ros-args', '--log-level', LaunchConfiguration('log_level')],
         on_exit=Shutdown(),
+        condition=UnlessCondition(use_container),
         #prefix=['xterm -e gdb -ex=r --args'],
         )
 
+    synapse_ros_component = LoadComposableNodes(
+        target_container=container,
+        composable_node_descriptions=[
+            ComposableNode(
+                namespace='cerebri',
+                package='synapse_ros',
+                plugin='SynapseRos',
+                name='synapse_ros',
+                parameters=parameters,
+                extra_arguments=[{'use_intra_process_comms': True}],
+                ),
+        ],
+        condition=IfCondition(use_container),
+        )
+
     ld = LaunchDescription(ARGUMENTS)
     ld.add_action(synapse_ros)
+    ld.add_action(synapse_ros_component)
     return ld
-
@@ -0,0 +1,105 @@
+#include "clock_sync.hpp"
+
+// an offset this far from the prediction is a clock step (e.g. cerebri
+// rebooted and its uptime restarted), the estimate starts over
+static constexpr int64_t step_ns = ns_per_sec;
+
+void ClockSync::add_sample(int64_t remote_ns, int64_t local_ns)
+{
+    if (round_trips_) {
+        return;
+    }
+    int64_t offset = local_ns - remote_ns;
+    add(remote_ns, offset, offset - predict(remote_ns), 0);
+}
+
+void ClockSync::add_round_trip(int64_t remote_ns, int64_t send_ns, int64_t recv_ns)
+{
+    int64_t rtt = recv_ns - send_ns;
+    if (rtt < 0) {
+        return;
+    }
+    if (!round_trips_) {
+        // switch from one way samples, the estimate restarts on round trips
+        round_trips_ = true;
+        current_.samples = 0;
+    }
+    // midpoint without overflowing the sum
+    int64_t local = send_ns + rtt / 2;
+    add(remote_ns, local - remote_ns, rtt, rtt);
+}
+
+void ClockSync::add(int64_t remote_ns, int64_t offset, int64_t key, int64_t rtt_ns)
+{
+    int64_t error = offset - predict(remote_ns);
+    if (current_.samples == 0 || error > step_ns || error < -step_ns) {
+        current_ = Estimate { remote_ns, offset, 0, 1, rtt_ns };
+        window_min_ = Sample { remote_ns, offset, key, rtt_ns };
+        window_count_ = 1;
+        have_last_min_ = false;
+        publish(current_);
+        return;
+    }
+
+    ++current_.samples;
+    if (window_count_ == 0 || key < window_min_.key) {
+        window_min_ = Sample { remote_ns, offset, key, rtt_ns };
+    }
+    if (++window_count_ < window_size) {
+        return;
+    }
+
+    // window complete, its selected sample becomes the new anchor
+    int64_t drift = current_.drift_ppb;
+    if (have_last_min_) {
+        int64_t dt = window_min_.remote_ns - last_min_.remote_ns;
+        if (dt > 0) {
+            // cold path, once per window, the slope is taken in double to
+            // keep offset_delta * 1e9 from overflowing on long windows
+            double slope = (double)(window_min_.offset_ns - last_min_.offset_ns) / dt;
+            int64_t measured = (int64_t)(slope * ns_per_sec);
+            if (measured > max_drift_ppb || measured < -max_drift_ppb) {
+                measured = 0;
+            }
+            // light smoothing, the selected sample is already filtered
+            drift = (3 * drift + measured) / 4;
+        }
+    }
+
+    current_ = Estimate { window_min_.remote_ns, window_min_.offset_ns, drift, current_.samples, window_min_.rtt_ns };
+    last_min_ = window_min_;
+    have_last_min_ = true;
+    window_count_ = 0;
+    publish(current_);
+}
+
+void ClockSync::publish(const Estimate& e)
+{
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ref_ns_.store(e.ref_ns, std::memory_order_relaxed);
+    offset_ns_.store(e.offset_ns, std::memory_order_relaxed);
+    drift_ppb_.store(e.drift_ppb, std::memory_order_relaxed);
+    samples_.store(e.samples, std::memory_order_relaxed);
+    rtt_ns_.store(e.rtt_ns, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+}
+
+ClockSync::Estimate ClockSync::estimate() const
+{
+    Estimate e;
+    uint32_t seq;
+    do {
+        seq = seq_.load(std::memory_order_acquire);
+        e.ref_ns = ref_ns_.load(std::memory_order_relaxed);
+        e.offset_ns = offset_ns_.load(std::memory_order_relaxed);
+        e.drift_ppb = drift_ppb_.load(std::memory_order_relaxed);
+        e.samples = samples_.load(std::memory_order_relaxed);
+        e.rtt_ns = rtt_ns_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != seq_.load(std::memory_order_relaxed));
+    return e;
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,117 @@
+#ifndef SYNAPSE_ROS_CLOCK_SYNC_HPP__
+#define SYNAPSE_ROS_CLOCK_SYNC_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+#include <builtin_interfaces/msg/time.hpp>
+
+// cerebri -> ROS clock translation.
+//
+// One way samples pair a cerebri uptime with the ROS time it was received
+// at, the window keeps the minimum (ros - uptime) which filters out delay
+// spikes but leaves the one way latency in the offset. Round trip samples
+// from the time sync ping-pong take the midpoint of send and receive and
+// the window keeps the one with the smallest round trip time, which also
+// cancels the latency for a symmetric link. Once round trips arrive one way
+// samples are ignored. The drift is the slope between the selected
+// samples of consecutive windows. Everything is int64 nanoseconds, drift
+// is in parts per billion.
+//
+// One thread adds samples, any thread may translate. The estimate is
+// published through a seqlock so readers never block the writer.
+
+static constexpr int64_t ns_per_sec = 1000000000;
+
+inline int64_t stamp_to_ns(int64_t sec, int64_t nanosec)
+{
+    return sec * ns_per_sec + nanosec;
+}
+
+// floor division so negative times keep 0 <= nanosec < 1e9
+inline void ns_to_stamp(int64_t ns, builtin_interfaces::msg::Time& stamp)
+{
+    int64_t sec = ns / ns_per_sec;
+    int64_t nanosec = ns % ns_per_sec;
+    int64_t borrow = nanosec >> 63;
+    stamp.sec = sec + borrow;
+    stamp.nanosec = nanosec + (borrow & ns_per_sec);
+}
+
+class ClockSync {
+public:
+    struct Estimate {
+        // remote time the estimate is anchored at
+        int64_t ref_ns;
+        // local - remote at ref_ns
+        int64_t offset_ns;
+        int64_t drift_ppb;
+        uint64_t samples;
+        // round trip time of the anchor sample, 0 for one way samples
+        int64_t rtt_ns;
+    };
+
+    // samples per window, the minimum of a window becomes the new estimate
+    static constexpr uint32_t window_size = 16;
+    // drift estimates beyond this are treated as clock steps, 1000 ppm
+    static constexpr int64_t max_drift_ppb = 1000000;
+
+    // writer: cerebri uptime remote_ns was received at ROS time local_ns
+    void add_sample(int64_t remote_ns, int64_t local_ns);
+
+    // writer: a ping sent at ROS time send_ns was answered with cerebri
+    // uptime remote_ns and the answer received at ROS time recv_ns
+    void add_round_trip(int64_t remote_ns, int64_t send_ns, int64_t recv_ns);
+
+    // reader: remote time to local time, identity until the first sample
+    int64_t to_local(int64_t remote_ns) const
+    {
+        Estimate e = estimate();
+        return remote_ns + e.offset_ns + scale_ppb(remote_ns - e.ref_ns, e.drift_ppb);
+    }
+
+    Estimate estimate() const;
+
+private:
+    // writer: offset the current estimate expects at remote_ns
+    int64_t predict(int64_t remote_ns) const
+    {
+        return current_.offset_ns + scale_ppb(remote_ns - current_.ref_ns, current_.drift_ppb);
+    }
+
+    // dt * ppb / 1e9 without overflowing for any dt
+    static int64_t scale_ppb(int64_t dt, int64_t ppb)
+    {
+        return (dt / ns_per_sec) * ppb + (dt % ns_per_sec) * ppb / ns_per_sec;
+    }
+
+    // key orders samples inside a window, the smallest one is kept
+    void add(int64_t remote_ns, int64_t offset_ns, int64_t key, int64_t rtt_ns);
+    void publish(const Estimate& e);
+
+    // writer state
+    struct Sample {
+        int64_t remote_ns;
+        int64_t offset_ns;
+        int64_t key;
+        int64_t rtt_ns;
+    };
+    bool round_trips_ { false };
+    Sample window_min_ {};
+    uint32_t window_count_ { 0 };
+    Sample last_min_ {};
+    bool have_last_min_ { false };
+    Estimate current_ {};
+
+    // published estimate
+    std::atomic<uint32_t> seq_ { 0 };
+    std::atomic<int64_t> ref_ns_ { 0 };
+    std::atomic<int64_t> offset_ns_ { 0 };
+    std::atomic<int64_t> drift_ppb_ { 0 };
+    std::atomic<uint64_t> samples_ { 0 };
+    std::atomic<int64_t> rtt_ns_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_CLOCK_SYNC_HPP__
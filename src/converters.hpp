@@ -0,0 +1,84 @@
+#ifndef SYNAPSE_ROS_CONVERTERS_HPP__
+#define SYNAPSE_ROS_CONVERTERS_HPP__
+
+#include <builtin_interfaces/msg/time.hpp>
+#include <std_msgs/msg/header.hpp>
+
+#include <synapse_msgs/msg/status.hpp>
+#include <synapse_protobuf/status.pb.h>
+
+#include <synapse_protobuf/time.pb.h>
+
+#include "clock_sync.hpp"
+
+// Protobuf -> ROS converters for inbound topics. They are inline so the
+// dispatch table in topics.hpp compiles each one into its handler, and they
+// write into a caller owned (reused or loaned) ROS message.
+
+// per link state the converters need
+struct ConvertContext {
+    // cerebri -> ros time, updated from the uptime topic
+    ClockSync clock {};
+};
+
+// frame ids are a handful of constant strings per topic, the reused ROS
+// message already holds the right one almost every time, so compare before
+// copying instead of assigning a new string per message
+inline void assign_frame_id(std::string& ros_frame_id, const std::string& frame_id)
+{
+    if (ros_frame_id != frame_id) {
+        ros_frame_id.assign(frame_id);
+    }
+}
+
+inline void compute_header(const synapse::msgs::Header& msg, std_msgs::msg::Header& ros_msg, const ConvertContext& ctx)
+{
+    assign_frame_id(ros_msg.frame_id, msg.frame_id());
+    if (msg.has_stamp()) {
+        int64_t remote = stamp_to_ns(msg.stamp().sec(), msg.stamp().nanosec());
+        ns_to_stamp(ctx.clock.to_local(remote), ros_msg.stamp);
+    } else {
+        ros_msg.stamp.sec = 0;
+        ros_msg.stamp.nanosec = 0;
+    }
+}
+
+inline void clear_header(std_msgs::msg::Header& ros_msg)
+{
+    ros_msg.frame_id.clear();
+    ros_msg.stamp.sec = 0;
+    ros_msg.stamp.nanosec = 0;
+}
+
+inline void status_to_ros(const synapse::msgs::Status& msg, synapse_msgs::msg::Status& ros_msg, const ConvertContext& ctx)
+{
+    // header
+    if (msg.has_header()) {
+        compute_header(msg.header(), ros_msg.header, ctx);
+    } else {
+        clear_header(ros_msg.header);
+    }
+
+    ros_msg.arming = msg.arming();
+    ros_msg.fuel = msg.fuel();
+    ros_msg.joy = msg.joy();
+    ros_msg.mode = msg.mode();
+    ros_msg.safety = msg.safety();
+    ros_msg.fuel_percentage = msg.fuel_percentage();
+    ros_msg.power = msg.power();
+    ros_msg.status_message.assign(msg.status_message());
+    ros_msg.request_rejected = msg.request_rejected();
+    ros_msg.request_seq = msg.request_seq();
+}
+
+// cerebri uptime, published as is, the clock estimate is fed separately
+inline void uptime_to_ros(const synapse::msgs::Time& msg, builtin_interfaces::msg::Time& ros_msg, const ConvertContext& ctx)
+{
+    (void)ctx;
+    ros_msg.sec = msg.sec();
+    ros_msg.nanosec = msg.nanosec();
+}
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_CONVERTERS_HPP__
@@ -0,0 +1,48 @@
+#include "encoders.hpp"
+
+template <typename T>
+static int serialize(const T& syn_msg, uint8_t* buf, uint32_t len)
+{
+    size_t size = syn_msg.ByteSizeLong();
+    if (size > len) {
+        return -1;
+    }
+    syn_msg.SerializeWithCachedSizesToArray(buf);
+    return (int)size;
+}
+
+int JoyEncoder::encode(const sensor_msgs::msg::Joy& msg, uint8_t* buf, uint32_t len)
+{
+    syn_msg_.Clear();
+
+    auto axes = syn_msg_.mutable_axes();
+    axes->Reserve(msg.axes.size());
+    for (auto i = 0u; i < msg.axes.size(); ++i) {
+        axes->AddAlreadyReserved(msg.axes[i]);
+    }
+
+    auto buttons = syn_msg_.mutable_buttons();
+    buttons->Reserve(msg.buttons.size());
+    for (auto i = 0u; i < msg.buttons.size(); ++i) {
+        buttons->AddAlreadyReserved(msg.buttons[i]);
+    }
+
+    return serialize(syn_msg_, buf, len);
+}
+
+int RoadCurveAngleEncoder::encode(const synapse_msgs::msg::RoadCurveAngle& msg, uint8_t* buf, uint32_t len)
+{
+    // every field is overwritten, there is nothing for Clear() to reset
+
+    // header
+    syn_msg_.mutable_header()->set_frame_id(msg.header.frame_id);
+    syn_msg_.mutable_header()->mutable_stamp()->set_sec(msg.header.stamp.sec);
+    syn_msg_.mutable_header()->mutable_stamp()->set_nanosec(msg.header.stamp.nanosec);
+
+    // vector
+    syn_msg_.set_angle(msg.angle);
+
+    return serialize(syn_msg_, buf, len);
+}
+
+// vi: ts=4 sw=4 et
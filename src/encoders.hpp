@@ -0,0 +1,38 @@
+#ifndef SYNAPSE_ROS_ENCODERS_HPP__
+#define SYNAPSE_ROS_ENCODERS_HPP__
+
+#include <cstdint>
+
+#include <sensor_msgs/msg/joy.hpp>
+#include <synapse_protobuf/joy.pb.h>
+
+#include <synapse_msgs/msg/road_curve_angle.hpp>
+#include <synapse_protobuf/road_curve_angle.pb.h>
+
+// Per-topic ROS -> protobuf encoders.
+//
+// Each encoder owns a protobuf message that is refilled on every call, so
+// repeated fields, strings and submessages keep their storage, and serializes
+// into a caller provided buffer. After the first message of a given shape
+// no heap allocation happens. encode() returns the serialized length, or -1
+// if the message does not fit in len bytes.
+
+class JoyEncoder {
+public:
+    int encode(const sensor_msgs::msg::Joy& msg, uint8_t* buf, uint32_t len);
+
+private:
+    synapse::msgs::Joy syn_msg_ {};
+};
+
+class RoadCurveAngleEncoder {
+public:
+    int encode(const synapse_msgs::msg::RoadCurveAngle& msg, uint8_t* buf, uint32_t len);
+
+private:
+    synapse::msgs::RoadCurveAngle syn_msg_ {};
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_ENCODERS_HPP__
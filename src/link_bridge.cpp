@@ -0,0 +1,489 @@
+#include "link_bridge.hpp"
+#include "proto/rx_arena.hpp"
+
+using std::placeholders::_1;
+
+const std::array<LinkBridge::Handler, topic_count> LinkBridge::dispatch_ = LinkBridge::make_dispatch(InboundTopics {});
+
+LinkBridge::LinkBridge(rclcpp::Node* node, boost::asio::io_context& io_context, const LinkBridgeConfig& config)
+    : node_(node)
+    , logger_(node->get_logger().get_child(config.name))
+    , config_(config)
+    , joy_throttle_(config.joy_throttle)
+    , road_curve_angle_throttle_(config.road_curve_angle_throttle)
+{
+    // subscriptions ros -> cerebri
+
+    joy_group_ = create_topic_group("joy");
+    road_curve_angle_group_ = create_topic_group("road_curve_angle");
+    raw_group_ = node_->create_callback_group(rclcpp::CallbackGroupType::Reentrant);
+
+    rclcpp::SubscriptionOptions joy_options;
+    joy_options.callback_group = joy_group_;
+    sub_joy_ = node_->create_subscription<sensor_msgs::msg::Joy>(
+        topic_name("in/joy"), topic_qos("joy"), std::bind(&LinkBridge::joy_callback, this, _1), joy_options);
+
+    rclcpp::SubscriptionOptions road_curve_angle_options;
+    road_curve_angle_options.callback_group = road_curve_angle_group_;
+    sub_road_curve_angle_ = node_->create_subscription<synapse_msgs::msg::RoadCurveAngle>(
+        topic_name("in/road_curve_angle"), topic_qos("road_curve_angle"), std::bind(&LinkBridge::road_curve_angle_callback, this, _1),
+        road_curve_angle_options);
+
+    joy_coalesce_timer_ = create_coalesce_timer(joy_throttle_, joy_group_,
+        [this](const sensor_msgs::msg::Joy& msg) { send_joy(msg); });
+    road_curve_angle_coalesce_timer_ = create_coalesce_timer(road_curve_angle_throttle_, road_curve_angle_group_,
+        [this](const synapse_msgs::msg::RoadCurveAngle& msg) { send_road_curve_angle(msg); });
+
+    // publications cerebri -> ros
+
+    create_publishers(InboundTopics {});
+
+    create_raw_topics();
+
+    pub_clock_offset_ = node_->create_publisher<builtin_interfaces::msg::Time>(
+        topic_name("out/clock_offset"), topic_qos("clock_offset"));
+
+    if (config_.clock_sync && config_.time_sync_period > 0) {
+        time_sync_timer_ = node_->create_wall_timer(
+            std::chrono::duration<double>(config_.time_sync_period),
+            std::bind(&LinkBridge::time_sync_ping, this));
+    }
+
+    // create the link for the configured transport
+    link_ = make_link(io_context, config_.link);
+    link_->set_handler(this);
+
+    // latency histograms for every bridged topic
+    topic_names_[SYNAPSE_JOY_TOPIC] = "in/joy";
+    topic_names_[SYNAPSE_ROAD_CURVE_ANGLE_TOPIC] = "in/road_curve_angle";
+    for (std::size_t i = 0; i < topic_count; ++i) {
+        if (!topic_names_[i].empty()) {
+            link_->latency_.enable(i);
+        }
+    }
+
+    // deferred log messages of the link and the hot paths of this bridge,
+    // the lazy publishers they asked for and the clock offset they updated
+    log_timer_ = node_->create_wall_timer(std::chrono::milliseconds(100), [this]() {
+        drain_log();
+        create_requested_publishers(InboundTopics {});
+        if (clock_offset_changed_.exchange(false, std::memory_order_relaxed)) {
+            publish_clock_offset();
+        }
+    });
+
+    link_->start();
+}
+
+void LinkBridge::drain_log()
+{
+    link_->log_.drain([this](const LogRing::Entry& entry) {
+        switch (entry.level) {
+        case LogLevel::Info:
+            RCLCPP_INFO(logger_, "%s", entry.text);
+            break;
+        case LogLevel::Warn:
+            RCLCPP_WARN(logger_, "%s", entry.text);
+            break;
+        case LogLevel::Error:
+            RCLCPP_ERROR(logger_, "%s", entry.text);
+            break;
+        }
+    });
+    uint64_t dropped = link_->log_.dropped();
+    if (dropped != log_dropped_) {
+        RCLCPP_WARN(logger_, "%lu log messages dropped, log queue full", (unsigned long)(dropped - log_dropped_));
+        log_dropped_ = dropped;
+    }
+}
+
+static int64_t steady_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LinkBridge::link_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status)
+{
+    LinkStatsSnapshot now;
+    link_->stats(now);
+    now[LinkCounter::TxThrottled] = joy_throttle_.suppressed() + road_curve_angle_throttle_.suppressed();
+    int64_t now_ns = steady_now_ns();
+    double dt = stats_last_ns_ > 0 ? (now_ns - stats_last_ns_) / 1e9 : 0;
+
+    auto add = [&](const std::string& key, const std::string& value) {
+        diagnostic_msgs::msg::KeyValue kv;
+        kv.key = key;
+        kv.value = value;
+        status.values.push_back(kv);
+    };
+    auto rate = [&](uint64_t total, uint64_t last) {
+        char value[32];
+        snprintf(value, sizeof(value), "%.1f", dt > 0 ? (total - last) / dt : 0.0);
+        return std::string(value);
+    };
+
+    std::string moved;
+    for (std::size_t i = 0; i < link_counter_count; ++i) {
+        LinkCounter c = (LinkCounter)i;
+        add(link_counter_names[i], std::to_string(now[c]));
+        if (link_counter_is_error(c) && now[c] != stats_last_[c]) {
+            moved += moved.empty() ? "" : ", ";
+            moved += link_counter_names[i];
+        }
+    }
+    for (LinkCounter c : { LinkCounter::RxDatagrams, LinkCounter::RxBytes, LinkCounter::TxDatagrams, LinkCounter::TxBytes }) {
+        add(std::string(link_counter_names[(std::size_t)c]) + "/s", rate(now[c], stats_last_[c]));
+    }
+    for (std::size_t id = 0; id < topic_count; ++id) {
+        if (!topic_names_[id].empty()) {
+            uint64_t frames = now.rx_topic[id] + now.tx_topic[id];
+            uint64_t last = stats_last_.rx_topic[id] + stats_last_.tx_topic[id];
+            add(topic_names_[id] + " msgs/s", rate(frames, last));
+        }
+    }
+    for (std::size_t c = 0; c < tx_class_count; ++c) {
+        const TxClassSnapshot& cls = now.tx_class[c];
+        const TxClassSnapshot& last = stats_last_.tx_class[c];
+        uint64_t frames = cls.frames - last.frames;
+        char value[96];
+        snprintf(value, sizeof(value), "depth=%lu wait_mean=%.1fus wait_max=%.1fus",
+            (unsigned long)cls.depth, frames > 0 ? (cls.wait_ns - last.wait_ns) / 1e3 / frames : 0.0,
+            cls.wait_max_ns / 1e3);
+        add(std::string("tx ") + tx_class_names[c], value);
+    }
+
+    status.level = moved.empty() ? diagnostic_msgs::msg::DiagnosticStatus::OK : diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = moved.empty() ? "ok" : "increasing: " + moved;
+    stats_last_ = now;
+    stats_last_ns_ = now_ns;
+}
+
+void LinkBridge::unknown_frame_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status) const
+{
+    for (int type = 0; type < 256; ++type) {
+        uint64_t count = link_->unknown_frames(type);
+        if (count == 0) {
+            continue;
+        }
+        diagnostic_msgs::msg::KeyValue kv;
+        kv.key = "type " + std::to_string(type);
+        kv.value = std::to_string(count);
+        status.values.push_back(kv);
+    }
+}
+
+std::string LinkBridge::topic_name(const std::string& name) const
+{
+    if (config_.prefix.empty()) {
+        return name;
+    }
+    return config_.prefix + "/" + name;
+}
+
+rclcpp::QoS LinkBridge::topic_qos(const std::string& key) const
+{
+    auto it = config_.qos.find(key);
+    return make_qos(it != config_.qos.end() ? it->second : reliable_qos);
+}
+
+template <typename... Topics>
+void LinkBridge::create_publishers(TopicList<Topics...>)
+{
+    if (!config_.lazy_publishers) {
+        (create_inbound_publisher<Topics>(), ...);
+    }
+    ((topic_names_[Topics::id] = Topics::name), ...);
+}
+
+template <typename T>
+void LinkBridge::create_inbound_publisher()
+{
+    auto& inbound = std::get<Inbound<T>>(inbound_);
+    inbound.pub = node_->create_publisher<typename T::ros_type>(topic_name(T::name), topic_qos(T::key));
+    inbound.ready.store(true, std::memory_order_release);
+}
+
+template <typename... Topics>
+void LinkBridge::create_requested_publishers(TopicList<Topics...>)
+{
+    auto requested = [](auto& topic) {
+        return topic.requested.load(std::memory_order_relaxed) && !topic.ready.load(std::memory_order_relaxed);
+    };
+    ((requested(std::get<Inbound<Topics>>(inbound_)) ? create_inbound_publisher<Topics>() : void()), ...);
+
+    for (std::size_t id = 0; id < topic_count; ++id) {
+        RawTopic* raw = raw_[id].get();
+        if (raw != NULL && requested(*raw)) {
+            raw->pub = node_->create_publisher<std_msgs::msg::UInt8MultiArray>(
+                topic_name(topic_names_[id]), topic_qos("raw"));
+            raw->ready.store(true, std::memory_order_release);
+        }
+    }
+}
+
+bool LinkBridge::dispatch(int topic, const uint8_t* data, uint32_t len, int64_t rx_stamp)
+{
+    if (!handles(topic)) {
+        return false;
+    }
+    if (raw_[topic]) {
+        publish_raw(*raw_[topic], data, len, rx_stamp, topic);
+    } else {
+        (this->*dispatch_[topic])(data, len, rx_stamp);
+    }
+    return true;
+}
+
+void LinkBridge::create_raw_topics()
+{
+    for (int64_t id : config_.raw_topics) {
+        if (id < 0 || id >= (int64_t)topic_count) {
+            RCLCPP_WARN(logger_, "raw topic id %ld out of range, ignored", id);
+            continue;
+        }
+        std::string name = "out/raw/" + std::to_string(id);
+        raw_[id] = std::make_unique<RawTopic>();
+        if (!config_.lazy_publishers) {
+            raw_[id]->pub = node_->create_publisher<std_msgs::msg::UInt8MultiArray>(topic_name(name), topic_qos("raw"));
+            raw_[id]->ready.store(true, std::memory_order_release);
+        }
+        topic_names_[id] = name;
+    }
+
+    for (int64_t id : config_.raw_inject_topics) {
+        if (id < 0 || id >= (int64_t)topic_count) {
+            RCLCPP_WARN(logger_, "raw inject topic id %ld out of range, ignored", id);
+            continue;
+        }
+        std::string name = "in/raw/" + std::to_string(id);
+        int topic = id;
+        rclcpp::SubscriptionOptions options;
+        options.callback_group = raw_group_;
+        sub_raw_.push_back(node_->create_subscription<std_msgs::msg::UInt8MultiArray>(
+            topic_name(name), topic_qos("raw"), [this, topic](const std_msgs::msg::UInt8MultiArray& msg) {
+                // the bytes are a serialized payload already, no decode
+                if (!link_->send(topic, msg.data.data(), msg.data.size(), config_.raw_overflow_policy)) {
+                    link_->log_.log(tx_error_log_, LogLevel::Warn, "Failed to send raw frame type:%d", topic);
+                }
+            },
+            options));
+        if (topic_names_[id].empty()) {
+            topic_names_[id] = name;
+        }
+    }
+}
+
+void LinkBridge::publish_raw(RawTopic& raw, const uint8_t* data, uint32_t len, int64_t rx_stamp, int topic)
+{
+    if (!publisher_ready(raw)) {
+        return;
+    }
+    // assign reuses the array's storage once it has grown to the payload
+    raw.msg.data.assign(data, data + len);
+    raw.pub->publish(raw.msg);
+    int64_t published = latency_now();
+    link_->latency_.record(topic, LatencyStage::RxPublish, rx_stamp, published);
+    link_->latency_.record(topic, LatencyStage::RxTotal, rx_stamp, published);
+}
+
+template <typename T>
+void LinkBridge::handle(const uint8_t* data, uint32_t len, int64_t rx_stamp)
+{
+    LatencyStats& latency = link_->latency_;
+    int64_t framed = latency_now();
+    latency.record(T::id, LatencyStage::RxFrame, rx_stamp, framed);
+
+    // parse protobuf message
+    auto syn_msg = google::protobuf::Arena::CreateMessage<typename T::proto_type>(&rx_arena());
+    if (!syn_msg->ParseFromArray(data, len)) {
+        link_->stats_.add(LinkCounter::RxDecodeErrors);
+        link_->log_.log(parse_error_log_, LogLevel::Warn, "Failed to parse %s", T::name);
+        return;
+    }
+    int64_t decoded = latency_now();
+    latency.record(T::id, LatencyStage::RxDecode, framed, decoded);
+
+    // cerebri reports the last command it processed, acks reliable frames
+    if constexpr (std::is_same_v<T, StatusTopic>) {
+        link_->reliable_ack(syn_msg->request_seq(), syn_msg->request_rejected() != 0);
+    }
+
+    // send to ros
+    auto& inbound = std::get<Inbound<T>>(inbound_);
+    if (!publisher_ready(inbound)) {
+        return;
+    }
+    if constexpr (std::is_same_v<T, UptimeTopic>) {
+        publish_uptime(*syn_msg);
+    } else {
+        publish_loaned(inbound.pub, inbound.msg, [&](typename T::ros_type& ros_msg) {
+            T::convert(*syn_msg, ros_msg, convert_context_);
+        });
+    }
+    int64_t published = latency_now();
+    latency.record(T::id, LatencyStage::RxPublish, decoded, published);
+    latency.record(T::id, LatencyStage::RxTotal, rx_stamp, published);
+}
+
+void LinkBridge::publish_uptime(const synapse::msgs::Time& msg)
+{
+    auto& inbound = std::get<Inbound<UptimeTopic>>(inbound_);
+    publish_loaned(inbound.pub, inbound.msg, [&](builtin_interfaces::msg::Time& ros_msg) {
+        UptimeTopic::convert(msg, ros_msg, convert_context_);
+    });
+}
+
+void LinkBridge::publish_clock_offset()
+{
+    ns_to_stamp(convert_context_.clock.estimate().offset_ns, clock_offset_msg_);
+    pub_clock_offset_->publish(clock_offset_msg_);
+}
+
+void LinkBridge::time_sync_ping()
+{
+    // the payload is informative, the send time is taken when the frame
+    // leaves the tx queue, see time_sync_sent
+    builtin_interfaces::msg::Time now = node_->now();
+    link_->send_encoded(SYNAPSE_UPTIME_TOPIC, OverflowPolicy::Reject, [&](uint8_t* buf, uint32_t len) {
+        synapse::msgs::Time ping;
+        ping.set_sec(now.sec);
+        ping.set_nanosec(now.nanosec);
+        if (ping.ByteSizeLong() > len) {
+            return -1;
+        }
+        ping.SerializeWithCachedSizesToArray(buf);
+        return (int)ping.GetCachedSize();
+    });
+}
+
+void LinkBridge::time_sync_sent(int frame_id)
+{
+    if (time_sync_timer_) {
+        time_sync_sent_[frame_id & 0xff].store(node_->now().nanoseconds(), std::memory_order_release);
+    }
+}
+
+bool LinkBridge::uptime_received(int frame_id, const uint8_t* data, uint32_t len)
+{
+    if (!config_.clock_sync) {
+        return false;
+    }
+    int64_t recv = node_->now().nanoseconds();
+    int64_t send = time_sync_sent_[frame_id & 0xff].exchange(0, std::memory_order_acquire);
+
+    synapse::msgs::Time uptime;
+    if (!uptime.ParseFromArray(data, len)) {
+        if (send == 0) {
+            // the dispatch counts and logs it
+            return false;
+        }
+        link_->stats_.add(LinkCounter::RxDecodeErrors);
+        link_->log_.log(parse_error_log_, LogLevel::Warn, "Failed to parse time sync response");
+        return true;
+    }
+    int64_t remote = stamp_to_ns(uptime.sec(), uptime.nanosec());
+
+    // unsolicited uptime, a one way sample until the first round trip
+    // arrives, firmware that never answers pings keeps the clock updated
+    if (send == 0) {
+        convert_context_.clock.add_sample(remote, recv);
+        clock_offset_changed_.store(true, std::memory_order_relaxed);
+        return false;
+    }
+    // a late answer to a ping whose id was reused, useless as a sample
+    if (recv - send > ns_per_sec) {
+        return true;
+    }
+    convert_context_.clock.add_round_trip(remote, send, recv);
+    clock_offset_changed_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void LinkBridge::latency_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status)
+{
+    char value[128];
+    for (std::size_t id = 0; id < topic_count; ++id) {
+        LatencyStats::Topic* topic = link_->latency_.topic(id);
+        if (topic == nullptr) {
+            continue;
+        }
+        for (std::size_t stage = 0; stage < latency_stage_count; ++stage) {
+            LatencySummary summary = topic->stages[stage].drain();
+            if (summary.count == 0) {
+                continue;
+            }
+            diagnostic_msgs::msg::KeyValue kv;
+            kv.key = topic_names_[id] + " " + latency_stage_names[stage];
+            snprintf(value, sizeof(value), "n=%lu mean=%.1fus p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus",
+                (unsigned long)summary.count, summary.mean_us, summary.p50_us,
+                summary.p99_us, summary.p999_us, summary.max_us);
+            kv.value = value;
+            status.values.push_back(kv);
+        }
+    }
+}
+
+
+rclcpp::CallbackGroup::SharedPtr LinkBridge::create_topic_group(const std::string& key)
+{
+    bool realtime = std::find(config_.realtime_topics.begin(), config_.realtime_topics.end(), key)
+        != config_.realtime_topics.end();
+    auto group = node_->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, !realtime);
+    if (realtime) {
+        realtime_groups_.push_back(group);
+    }
+    return group;
+}
+
+template <typename T, typename F>
+rclcpp::TimerBase::SharedPtr LinkBridge::create_coalesce_timer(TxThrottle<T>& throttle,
+    const rclcpp::CallbackGroup::SharedPtr& group, F&& send)
+{
+    if (!throttle.coalescing()) {
+        return nullptr;
+    }
+    // the subscription's group, serialized with the subscription callback
+    return node_->create_wall_timer(std::chrono::nanoseconds(throttle.period_ns()),
+        [&throttle, send]() {
+            if (const T* msg = throttle.tick()) {
+                send(*msg);
+            }
+        },
+        group);
+}
+
+void LinkBridge::joy_callback(const sensor_msgs::msg::Joy& msg)
+{
+    if (joy_throttle_.admit(msg, steady_now_ns())) {
+        send_joy(msg);
+    }
+}
+
+void LinkBridge::road_curve_angle_callback(const synapse_msgs::msg::RoadCurveAngle& msg)
+{
+    if (road_curve_angle_throttle_.admit(msg, steady_now_ns())) {
+        send_road_curve_angle(msg);
+    }
+}
+
+void LinkBridge::send_joy(const sensor_msgs::msg::Joy& msg)
+{
+    bool sent = link_->send_encoded(SYNAPSE_JOY_TOPIC, config_.joy_overflow_policy,
+        [&](uint8_t* buf, uint32_t len) { return joy_encoder_.encode(msg, buf, len); });
+    if (!sent) {
+        link_->log_.log(tx_error_log_, LogLevel::Warn, "Failed to send Joy");
+    }
+}
+
+void LinkBridge::send_road_curve_angle(const synapse_msgs::msg::RoadCurveAngle& msg)
+{
+    bool sent = link_->send_encoded(SYNAPSE_ROAD_CURVE_ANGLE_TOPIC, config_.road_curve_angle_overflow_policy,
+        [&](uint8_t* buf, uint32_t len) { return road_curve_angle_encoder_.encode(msg, buf, len); });
+    if (!sent) {
+        link_->log_.log(tx_error_log_, LogLevel::Warn, "Failed to send RoadCurveAngle");
+    }
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,287 @@
+#ifndef SYNAPSE_ROS_LINK_BRIDGE_HPP__
+#define SYNAPSE_ROS_LINK_BRIDGE_HPP__
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include <builtin_interfaces/msg/time.hpp>
+
+#include <rclcpp/rclcpp.hpp>
+
+#include <diagnostic_msgs/msg/diagnostic_status.hpp>
+
+#include <std_msgs/msg/u_int8_multi_array.hpp>
+
+#include <sensor_msgs/msg/joy.hpp>
+#include <synapse_protobuf/joy.pb.h>
+
+#include <synapse_msgs/msg/status.hpp>
+#include <synapse_protobuf/status.pb.h>
+
+#include <synapse_msgs/msg/road_curve_angle.hpp>
+#include <synapse_protobuf/road_curve_angle.pb.h>
+
+#include <synapse_tinyframe/SynapseTopics.h>
+
+#include "converters.hpp"
+#include "encoders.hpp"
+#include "proto/mpsc_queue.hpp"
+#include "proto/link.hpp"
+#include "qos.hpp"
+#include "topics.hpp"
+#include "tx_throttle.hpp"
+
+struct LinkBridgeConfig {
+    std::string name { "cerebri" };
+    // topic namespace relative to the node, empty for the default link
+    std::string prefix {};
+    LinkConfig link {};
+
+    // translate cerebri stamps to ros time from the uptime topic, otherwise
+    // stamps are passed through unchanged
+    bool clock_sync { true };
+    // ping-pong time sync period in seconds, 0 sends no pings and keeps
+    // to one way uptime samples
+    double time_sync_period { 0.0 };
+
+    // tx queue overflow policy per topic
+    OverflowPolicy joy_overflow_policy { OverflowPolicy::DropOldest };
+    OverflowPolicy road_curve_angle_overflow_policy { OverflowPolicy::DropOldest };
+
+    // qos per topic key (joy, status, ...), topics not listed use reliable_qos
+    std::map<std::string, TopicQosConfig> qos {};
+
+    // rate limiting, coalescing and on change forwarding per topic
+    TxThrottleConfig joy_throttle {};
+    TxThrottleConfig road_curve_angle_throttle {};
+
+    // passthrough, frames of these topic ids are published undecoded on
+    // out/raw/<id> instead of being converted, and bytes received on
+    // in/raw/<id> are sent as frames of that id
+    std::vector<int64_t> raw_topics {};
+    std::vector<int64_t> raw_inject_topics {};
+    OverflowPolicy raw_overflow_policy { OverflowPolicy::DropOldest };
+
+    // create inbound publishers once the first frame of their topic id
+    // arrived instead of at startup, topics cerebri never sends cost
+    // nothing. Frames of a topic are dropped (rx_unpublished) from its
+    // first frame until the log timer created the publisher, up to 100 ms,
+    // a Status sent only on change may be lost for good, hence off by
+    // default.
+    bool lazy_publishers { false };
+
+    // subscribed topics (by qos key) whose callback groups are left to the
+    // node's realtime executor instead of the node's executor
+    std::vector<std::string> realtime_topics {};
+};
+
+// Bridges one cerebri board: owns its Link (and with it the TinyFrame
+// instance) together with the ROS publications and subscriptions of that
+// board. All bridges of a node share the node's io_context.
+//
+// Subscription callbacks may run concurrently under a multi threaded
+// executor: they only encode into the link's lock-free tx queue, TinyFrame
+// is touched from the link's strand alone.
+class LinkBridge {
+public:
+    LinkBridge(rclcpp::Node* node, boost::asio::io_context& io_context, const LinkBridgeConfig& config);
+
+    const std::string& name() const { return config_.name; }
+
+    // shutdown, before the io threads stop, see Link::stop
+    void stop() { link_->stop(); }
+
+    // decode and publish a received frame, false if the topic is not bridged,
+    // rx_stamp is the latency_now() stamp of the datagram
+    bool dispatch(int topic, const uint8_t* data, uint32_t len, int64_t rx_stamp);
+
+    // true if dispatch() bridges the topic
+    bool handles(int topic) const
+    {
+        return topic >= 0 && topic < (int)topic_count && (dispatch_[topic] != nullptr || raw_[topic]);
+    }
+
+    // drain the latency histograms of this link into a diagnostic status
+    void latency_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status);
+
+    // link health counters, totals and rates since the previous call
+    void link_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status);
+
+    // frames received per unbridged topic id since start
+    void unknown_frame_diagnostics(diagnostic_msgs::msg::DiagnosticStatus& status) const;
+
+    // callback groups of the realtime topics, not added to the node's
+    // executor, the owner has to spin them
+    const std::vector<rclcpp::CallbackGroup::SharedPtr>& realtime_groups() const { return realtime_groups_; }
+
+    // publish the cerebri uptime
+    void publish_uptime(const synapse::msgs::Time& msg);
+
+    // time sync, a ping with TinyFrame id frame_id left the link (strand)
+    void time_sync_sent(int frame_id);
+    // rx context, the only writer of the clock estimate: an answer to a
+    // pending ping is a round trip sample and consumed (true), any other
+    // uptime is a one way sample and still published (false). Runs on the
+    // io thread before the rx workers, so it never publishes itself.
+    bool uptime_received(int frame_id, const uint8_t* data, uint32_t len);
+
+    // current cerebri -> ros clock estimate
+    ClockSync::Estimate clock_estimate() const { return convert_context_.clock.estimate(); }
+
+private:
+    rclcpp::Node* node_;
+    rclcpp::Logger logger_;
+    LinkBridgeConfig config_;
+    ConvertContext convert_context_ {};
+
+    // hot path log sites, written to the link's log ring and printed from
+    // the log timer
+    LogLimit parse_error_log_ {};
+    LogLimit tx_error_log_ {};
+    rclcpp::TimerBase::SharedPtr log_timer_;
+    uint64_t log_dropped_ { 0 };
+    void drain_log();
+
+    // previous link statistics, for rates
+    LinkStatsSnapshot stats_last_ {};
+    int64_t stats_last_ns_ { 0 };
+
+    std::string topic_name(const std::string& name) const;
+    rclcpp::QoS topic_qos(const std::string& key) const;
+
+    // ros topic name per synapse topic id, for diagnostics
+    std::array<std::string, topic_count> topic_names_ {};
+
+    // one callback group per subscribed topic, so a slow delivery of one
+    // topic does not hold up another. The coalescing timer of a topic shares
+    // its group since the throttle and the encoder are not thread safe. Raw
+    // injection only pushes into the tx queue and is reentrant.
+    rclcpp::CallbackGroup::SharedPtr joy_group_;
+    rclcpp::CallbackGroup::SharedPtr road_curve_angle_group_;
+    rclcpp::CallbackGroup::SharedPtr raw_group_;
+    std::vector<rclcpp::CallbackGroup::SharedPtr> realtime_groups_ {};
+    rclcpp::CallbackGroup::SharedPtr create_topic_group(const std::string& key);
+
+    // subscriptions ros -> cerebri
+    rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr sub_joy_;
+    rclcpp::Subscription<synapse_msgs::msg::RoadCurveAngle>::SharedPtr sub_road_curve_angle_;
+
+    // subscription callbacks
+    void joy_callback(const sensor_msgs::msg::Joy& msg);
+    void road_curve_angle_callback(const synapse_msgs::msg::RoadCurveAngle& msg);
+    void send_joy(const sensor_msgs::msg::Joy& msg);
+    void send_road_curve_angle(const synapse_msgs::msg::RoadCurveAngle& msg);
+
+    // traffic shaping, the coalescing timers only exist when enabled
+    TxThrottle<sensor_msgs::msg::Joy> joy_throttle_;
+    TxThrottle<synapse_msgs::msg::RoadCurveAngle> road_curve_angle_throttle_;
+    rclcpp::TimerBase::SharedPtr joy_coalesce_timer_;
+    rclcpp::TimerBase::SharedPtr road_curve_angle_coalesce_timer_;
+    template <typename T, typename F>
+    rclcpp::TimerBase::SharedPtr create_coalesce_timer(TxThrottle<T>& throttle,
+        const rclcpp::CallbackGroup::SharedPtr& group, F&& send);
+
+    // reused encoders, serialize straight into the tx queue
+    JoyEncoder joy_encoder_ {};
+    RoadCurveAngleEncoder road_curve_angle_encoder_ {};
+
+    // publications cerebri -> ros, one publisher and reused message per
+    // registered inbound topic, the message is only touched from the link's
+    // strand or the rx worker the topic is sharded to. A lazy publisher is
+    // requested from there and created by the log timer on the node's
+    // executor, creating it on the rx context would stall the hot path.
+    template <typename T>
+    struct Inbound {
+        typename rclcpp::Publisher<typename T::ros_type>::SharedPtr pub;
+        std::atomic<bool> requested { false };
+        std::atomic<bool> ready { false };
+        typename T::ros_type msg {};
+    };
+    template <typename... Topics>
+    static std::tuple<Inbound<Topics>...> make_inbound(TopicList<Topics...>);
+    decltype(make_inbound(InboundTopics {})) inbound_ {};
+
+    template <typename... Topics>
+    void create_publishers(TopicList<Topics...>);
+    template <typename T>
+    void create_inbound_publisher();
+    // node executor: create the publishers the rx context asked for
+    template <typename... Topics>
+    void create_requested_publishers(TopicList<Topics...>);
+
+    // rx context: true if topic's publisher exists, otherwise asks for it
+    // and counts the frame as unpublished
+    template <typename P>
+    bool publisher_ready(P& topic)
+    {
+        if (topic.ready.load(std::memory_order_acquire)) {
+            return true;
+        }
+        topic.requested.store(true, std::memory_order_relaxed);
+        link_->stats_.add(LinkCounter::RxUnpublished);
+        return false;
+    }
+
+    rclcpp::Publisher<builtin_interfaces::msg::Time>::SharedPtr pub_clock_offset_;
+    builtin_interfaces::msg::Time clock_offset_msg_ {};
+    // set by the rx context, published from the log timer, a publish on
+    // the io thread would stall the socket reads
+    std::atomic<bool> clock_offset_changed_ { false };
+    void publish_clock_offset();
+
+    // time sync pings in flight, ros send time indexed by TinyFrame id,
+    // written on the tx strand and taken on the rx context
+    rclcpp::TimerBase::SharedPtr time_sync_timer_;
+    std::array<std::atomic<int64_t>, 256> time_sync_sent_ {};
+    void time_sync_ping();
+
+    // flat rx dispatch table indexed by topic id
+    using Handler = void (LinkBridge::*)(const uint8_t* data, uint32_t len, int64_t rx_stamp);
+    template <typename T>
+    void handle(const uint8_t* data, uint32_t len, int64_t rx_stamp);
+    template <typename... Topics>
+    static constexpr std::array<Handler, topic_count> make_dispatch(TopicList<Topics...>)
+    {
+        std::array<Handler, topic_count> table {};
+        ((table[Topics::id] = &LinkBridge::handle<Topics>), ...);
+        return table;
+    }
+    static const std::array<Handler, topic_count> dispatch_;
+
+    // passthrough topics, the payload is copied into a reused byte array,
+    // the subscription injects received bytes unchanged
+    struct RawTopic {
+        rclcpp::Publisher<std_msgs::msg::UInt8MultiArray>::SharedPtr pub;
+        std::atomic<bool> requested { false };
+        std::atomic<bool> ready { false };
+        std_msgs::msg::UInt8MultiArray msg {};
+    };
+    std::array<std::unique_ptr<RawTopic>, topic_count> raw_ {};
+    std::vector<rclcpp::Subscription<std_msgs::msg::UInt8MultiArray>::SharedPtr> sub_raw_ {};
+    void create_raw_topics();
+    void publish_raw(RawTopic& raw, const uint8_t* data, uint32_t len, int64_t rx_stamp, int topic);
+
+    // Publish a message filled in place by fill(T&). When the middleware can
+    // loan memory for T (e.g. iceoryx or cyclone shm with a fixed size type)
+    // the message is written straight into the loan, otherwise the reused
+    // fallback message is filled and published by copy.
+    template <typename T, typename F>
+    static void publish_loaned(const typename rclcpp::Publisher<T>::SharedPtr& pub, T& fallback, F&& fill)
+    {
+        if (pub->can_loan_messages()) {
+            auto loaned = pub->borrow_loaned_message();
+            fill(loaned.get());
+            pub->publish(std::move(loaned));
+        } else {
+            fill(fallback);
+            pub->publish(fallback);
+        }
+    }
+
+    std::shared_ptr<Link> link_ {};
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_LINK_BRIDGE_HPP__
@@ -0,0 +1,16 @@
+#include "synapse_ros.hpp"
+
+int main(int argc, char** argv)
+{
+    rclcpp::init(argc, argv);
+    // subscriptions are in per topic callback groups, let bulk topics run
+    // in parallel, the realtime topics have their own thread in the node
+    rclcpp::executors::MultiThreadedExecutor executor;
+    auto node = std::make_shared<SynapseRos>();
+    executor.add_node(node);
+    executor.spin();
+    rclcpp::shutdown();
+    return 0;
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,151 @@
+#include "flight_recorder.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FlightRecorder::~FlightRecorder()
+{
+    if (header_ != nullptr) {
+        msync(header_, mapped_size_, MS_ASYNC);
+        munmap(header_, mapped_size_);
+    }
+}
+
+bool FlightRecorder::open(const std::string& path, uint64_t capacity)
+{
+    capacity = (capacity + 15) & ~(uint64_t)15;
+    std::size_t size = flight_recorder_header_size + capacity;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "flight recorder: open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // allocate the blocks now, a sparse file would allocate on first write
+    int err = posix_fallocate(fd, 0, size);
+    if (err != 0) {
+        std::cerr << "flight recorder: allocate " << size << " bytes: " << strerror(err) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "flight recorder: mmap: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // touch every page so recording never faults
+    memset(p, 0, size);
+
+    header_ = (FlightRecorderHeader*)p;
+    ring_ = (uint8_t*)p + flight_recorder_header_size;
+    mapped_size_ = size;
+    memcpy(header_->magic, flight_recorder_magic, sizeof(header_->magic));
+    header_->version = flight_recorder_version;
+    header_->header_size = flight_recorder_header_size;
+    header_->capacity = capacity;
+    return true;
+}
+
+void FlightRecorder::record(RecordDirection direction, const uint8_t* data, uint32_t len, int64_t stamp_ns)
+{
+    if (header_ == nullptr) {
+        return;
+    }
+    if (busy_.test_and_set(std::memory_order_acquire)) {
+        __atomic_fetch_add(&header_->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    append(direction, data, len, stamp_ns);
+    busy_.clear(std::memory_order_release);
+}
+
+void FlightRecorder::append(RecordDirection direction, const uint8_t* data, uint32_t len, int64_t stamp_ns)
+{
+    uint64_t size = FlightRecording::record_size(len);
+    if (size > header_->capacity) {
+        __atomic_fetch_add(&header_->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // records never wrap, pad the end of the ring instead
+    uint64_t pos = header_->head % header_->capacity;
+    if (pos + size > header_->capacity) {
+        uint64_t pad = header_->capacity - pos;
+        reserve(pad);
+        RecordHeader* padding = (RecordHeader*)(ring_ + pos);
+        padding->len = pad - sizeof(RecordHeader);
+        padding->direction = RecordDirection::Padding;
+        padding->stamp_ns = stamp_ns;
+        header_->head += pad;
+        pos = 0;
+    }
+
+    reserve(size);
+    RecordHeader* record = (RecordHeader*)(ring_ + pos);
+    record->len = len;
+    record->direction = direction;
+    record->stamp_ns = stamp_ns;
+    memcpy(ring_ + pos + sizeof(RecordHeader), data, len);
+    header_->head += size;
+}
+
+void FlightRecorder::reserve(uint64_t size)
+{
+    // drop the oldest records until size bytes are free
+    while (header_->head + size - header_->tail > header_->capacity) {
+        const RecordHeader* oldest = (const RecordHeader*)(ring_ + header_->tail % header_->capacity);
+        header_->tail += FlightRecording::record_size(oldest->len);
+    }
+}
+
+FlightRecording::~FlightRecording()
+{
+    if (header_ != nullptr) {
+        munmap((void*)header_, mapped_size_);
+    }
+}
+
+bool FlightRecording::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "flight recording: open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < flight_recorder_header_size) {
+        std::cerr << "flight recording: " << path << " is too small" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "flight recording: mmap: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    const FlightRecorderHeader* header = (const FlightRecorderHeader*)p;
+    if (memcmp(header->magic, flight_recorder_magic, sizeof(header->magic)) != 0
+        || header->version != flight_recorder_version
+        || header->header_size + header->capacity > (uint64_t)st.st_size) {
+        std::cerr << "flight recording: " << path << " is not a capture" << std::endl;
+        munmap(p, st.st_size);
+        return false;
+    }
+
+    header_ = header;
+    ring_ = (const uint8_t*)p + header->header_size;
+    mapped_size_ = st.st_size;
+    return true;
+}
+
+// vi: ts=4 sw=4 et
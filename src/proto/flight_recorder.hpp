@@ -0,0 +1,129 @@
+#ifndef SYNAPSE_ROS_PROTO_FLIGHT_RECORDER_HPP__
+#define SYNAPSE_ROS_PROTO_FLIGHT_RECORDER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Flight recorder for raw link traffic.
+//
+// Datagrams are appended with their monotonic stamp to a preallocated,
+// memory mapped ring file, the oldest records are overwritten once it is
+// full. Recording is a memcpy into mapped memory: the file is allocated and
+// touched when opened so the io thread never takes a page fault on a new
+// block, and a writer that finds the recorder busy (rx busy poll thread vs
+// tx strand) drops the record instead of waiting.
+//
+// File layout: a FlightRecorderHeader padded to 64 bytes, then the ring.
+// Records are 16 byte aligned RecordHeader + payload and never wrap, the
+// end of the ring is filled with a padding record instead.
+
+enum class RecordDirection : uint8_t {
+    Rx = 1,
+    Tx = 2,
+    Padding = 0xff,
+};
+
+struct FlightRecorderHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t capacity;
+    // virtual offsets, ring position is offset % capacity
+    uint64_t head;
+    uint64_t tail;
+    // bumped without the busy flag, access with __atomic builtins
+    uint64_t dropped;
+};
+
+struct RecordHeader {
+    uint32_t len;
+    RecordDirection direction;
+    uint8_t reserved[3];
+    int64_t stamp_ns;
+};
+
+static constexpr char flight_recorder_magic[8] = { 'S', 'Y', 'N', 'R', 'E', 'C', '0', '1' };
+static constexpr uint32_t flight_recorder_version = 1;
+static constexpr uint32_t flight_recorder_header_size = 64;
+
+static_assert(sizeof(FlightRecorderHeader) <= flight_recorder_header_size, "header must fit its reserved space");
+static_assert(sizeof(RecordHeader) == 16, "records are 16 byte aligned");
+
+// records are stamped with the steady clock even when latency stats are
+// compiled out
+inline int64_t recorder_now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+class FlightRecorder {
+public:
+    FlightRecorder() = default;
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    ~FlightRecorder();
+
+    // create (or truncate) path with a ring of capacity bytes, false and a
+    // message on std::cerr on failure
+    bool open(const std::string& path, uint64_t capacity);
+    bool is_open() const { return header_ != nullptr; }
+    uint64_t dropped() const { return header_ ? __atomic_load_n(&header_->dropped, __ATOMIC_RELAXED) : 0; }
+
+    // append one datagram, drops it when another thread is recording
+    void record(RecordDirection direction, const uint8_t* data, uint32_t len, int64_t stamp_ns);
+
+private:
+    void append(RecordDirection direction, const uint8_t* data, uint32_t len, int64_t stamp_ns);
+    void reserve(uint64_t size);
+
+    FlightRecorderHeader* header_ { nullptr };
+    uint8_t* ring_ { nullptr };
+    std::size_t mapped_size_ { 0 };
+    std::atomic_flag busy_ = ATOMIC_FLAG_INIT;
+};
+
+// Read side, iterates the records of a capture from oldest to newest.
+class FlightRecording {
+public:
+    FlightRecording() = default;
+    FlightRecording(const FlightRecording&) = delete;
+    FlightRecording& operator=(const FlightRecording&) = delete;
+    ~FlightRecording();
+
+    bool open(const std::string& path);
+    uint64_t dropped() const { return header_ ? header_->dropped : 0; }
+
+    // f(const RecordHeader&, const uint8_t* payload)
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        uint64_t offset = header_->tail;
+        while (offset < header_->head) {
+            const uint8_t* p = ring_ + offset % header_->capacity;
+            const RecordHeader* record = (const RecordHeader*)p;
+            if (record->direction != RecordDirection::Padding) {
+                f(*record, p + sizeof(RecordHeader));
+            }
+            offset += record_size(record->len);
+        }
+    }
+
+    static uint64_t record_size(uint32_t len)
+    {
+        return (sizeof(RecordHeader) + len + 15) & ~(uint64_t)15;
+    }
+
+private:
+    const FlightRecorderHeader* header_ { nullptr };
+    const uint8_t* ring_ { nullptr };
+    std::size_t mapped_size_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_FLIGHT_RECORDER_HPP__
@@ -0,0 +1,285 @@
+#ifndef SYNAPSE_ROS_PROTO_FRAME_CODEC_HPP__
+#define SYNAPSE_ROS_PROTO_FRAME_CODEC_HPP__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Optional payload encoding for bandwidth limited links (telemetry radio).
+//
+// An encoded payload starts with a mode byte and a key sequence number:
+//
+//   Key    [0][seq][payload]               the payload itself, it becomes
+//                                          reference frame seq of the topic
+//   Delta  [1][seq][len][zeros lits ...]   the payload XORed with reference
+//                                          seq, len and the run lengths are
+//                                          varints, each zeros / lits pair is
+//                                          followed by lits literal bytes
+//
+// Consecutive Status frames differ in a few bytes and joy axes mostly in
+// their low bits, the XOR leaves runs of zeros which the run lengths drop.
+// Deltas refer to the last key frame rather than the previous frame, so a
+// lost datagram only costs the frames up to the next key, which is sent
+// every key_interval frames or whenever a delta would not be smaller.
+// Reliable topics are always sent as keys, a resend must not depend on a
+// reference that moved on meanwhile.
+//
+// Deltas against the last acked frame would need an ack for every
+// streaming frame, which UDP telemetry does not have (only reliable
+// topics are acked, through Status), and a general purpose compressor
+// like LZ4 gains little on short protobuf payloads while adding a
+// dependency. The sender therefore picks its own reference, the last key.
+// The price is that a lost key makes every delta up to the next key
+// undecodable, at most key_interval - 1 frames of the topic, which are
+// counted as rx codec errors and dropped.
+//
+// Encoding is negotiated per link on the control topic: the bridge offers
+// [version][topic ids...] every offer period, cerebri answers with the same
+// layout listing the topics it encodes and decodes. An answer is valid for
+// a few offer periods, a board that reboots into firmware without the codec
+// stops answering and the link falls back to plain payloads.
+//
+// encode() runs on the tx strand, accept() and decode() on the rx context.
+class FrameCodec {
+public:
+    static constexpr uint8_t version = 1;
+    static constexpr uint32_t header_length = 2;
+    static constexpr int64_t offer_period_ns = 1000000000;
+    static constexpr int64_t accept_lifetime_ns = 3 * offer_period_ns;
+
+    enum : uint8_t {
+        Key,
+        Delta,
+    };
+
+    FrameCodec(int control_topic, const std::vector<int64_t>& topics, uint32_t key_interval)
+        : control_topic_(control_topic)
+        , key_interval_(std::max<uint32_t>(key_interval, 1))
+    {
+        for (int64_t topic : topics) {
+            if (topic >= 0 && topic < (int64_t)offered_.size() && topic != control_topic) {
+                offered_[topic] = true;
+            }
+        }
+    }
+
+    int control_topic() const { return control_topic_; }
+
+    // payload of the offer frame, the length written
+    uint32_t offer(uint8_t* buf, uint32_t size) const
+    {
+        uint32_t n = 0;
+        if (n < size) {
+            buf[n++] = version;
+        }
+        for (std::size_t topic = 0; topic < offered_.size() && n < size; ++topic) {
+            if (offered_[topic]) {
+                buf[n++] = topic;
+            }
+        }
+        return n;
+    }
+
+    // rx context: cerebri's answer to the offer, false if malformed or of
+    // another version. The first answer after the codec lapsed starts
+    // afresh on both ends.
+    bool accept(const uint8_t* data, uint32_t len, int64_t now_ns)
+    {
+        if (len < 1 || data[0] != version) {
+            return false;
+        }
+        bool lapsed = !active(now_ns);
+        for (std::size_t topic = 0; topic < active_.size(); ++topic) {
+            bool agreed = offered_[topic] && std::memchr(data + 1, (int)topic, len - 1) != NULL;
+            active_[topic].store(agreed, std::memory_order_relaxed);
+        }
+        if (lapsed) {
+            for (Reference& ref : rx_) {
+                ref.valid = false;
+            }
+            epoch_.fetch_add(1, std::memory_order_relaxed);
+        }
+        accepted_until_ns_.store(now_ns + accept_lifetime_ns, std::memory_order_release);
+        return true;
+    }
+
+    bool active(int64_t now_ns) const { return now_ns < accepted_until_ns_.load(std::memory_order_acquire); }
+    bool active(int topic, int64_t now_ns) const
+    {
+        return active_[topic & 0xff].load(std::memory_order_relaxed) && active(now_ns);
+    }
+
+    // strand: encode len bytes of topic into out, which holds at least
+    // len + header_length bytes, returns the encoded length
+    uint32_t encode(int topic, const uint8_t* data, uint32_t len, uint8_t* out, bool key_only)
+    {
+        uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+        if (epoch != tx_epoch_) {
+            for (Reference& ref : tx_) {
+                ref.valid = false;
+            }
+            tx_epoch_ = epoch;
+        }
+
+        Reference& ref = tx_[topic & 0xff];
+        if (!key_only && ref.valid && ref.since_key < key_interval_) {
+            uint32_t n = encode_delta(ref, data, len, out, len + header_length);
+            if (n > 0) {
+                ref.since_key++;
+                return n;
+            }
+        }
+
+        // key, the new reference
+        ref.seq++;
+        ref.valid = true;
+        ref.since_key = 1;
+        ref.data.assign(data, data + len);
+        out[0] = Key;
+        out[1] = ref.seq;
+        memcpy(out + header_length, data, len);
+        return len + header_length;
+    }
+
+    // rx context: decode into out of size bytes, the decoded length or -1
+    // if the payload is malformed or refers to a reference not received
+    int decode(int topic, const uint8_t* data, uint32_t len, uint8_t* out, uint32_t size)
+    {
+        if (len < header_length) {
+            return -1;
+        }
+        Reference& ref = rx_[topic & 0xff];
+        uint32_t body = len - header_length;
+        if (data[0] == Key) {
+            if (body > size) {
+                return -1;
+            }
+            ref.seq = data[1];
+            ref.valid = true;
+            ref.data.assign(data + header_length, data + len);
+            memcpy(out, data + header_length, body);
+            return body;
+        }
+        if (data[0] != Delta || !ref.valid || ref.seq != data[1]) {
+            return -1;
+        }
+        return decode_delta(ref, data + header_length, body, out, size);
+    }
+
+private:
+    struct Reference {
+        std::vector<uint8_t> data {};
+        uint8_t seq { 0 };
+        bool valid { false };
+        uint32_t since_key { 0 };
+    };
+
+    static uint32_t put_varint(uint8_t* out, uint32_t n, uint32_t limit, uint32_t value)
+    {
+        while (n < limit) {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            out[n++] = byte | (value ? 0x80 : 0);
+            if (!value) {
+                return n;
+            }
+        }
+        return 0;
+    }
+
+    static bool get_varint(const uint8_t* data, uint32_t len, uint32_t& pos, uint32_t& value)
+    {
+        value = 0;
+        for (uint32_t shift = 0; pos < len && shift < 32; shift += 7) {
+            uint8_t byte = data[pos++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 0 if the delta does not fit below limit
+    static uint32_t encode_delta(const Reference& ref, const uint8_t* data, uint32_t len, uint8_t* out, uint32_t limit)
+    {
+        auto x = [&](uint32_t i) -> uint8_t {
+            return data[i] ^ (i < ref.data.size() ? ref.data[i] : 0);
+        };
+        out[0] = Delta;
+        out[1] = ref.seq;
+        uint32_t n = put_varint(out, header_length, limit, len);
+        uint32_t i = 0;
+        while (n > 0 && i < len) {
+            uint32_t zeros = 0;
+            while (i + zeros < len && x(i + zeros) == 0) {
+                zeros++;
+            }
+            // literals up to the next run of two zeros, a lone zero is
+            // cheaper inline than as a new pair
+            uint32_t start = i + zeros;
+            uint32_t end = start;
+            while (end < len && !(x(end) == 0 && (end + 1 == len || x(end + 1) == 0))) {
+                end++;
+            }
+            n = put_varint(out, n, limit, zeros);
+            n = n > 0 ? put_varint(out, n, limit, end - start) : 0;
+            if (n == 0 || n + (end - start) >= limit) {
+                return 0;
+            }
+            for (uint32_t j = start; j < end; ++j) {
+                out[n++] = x(j);
+            }
+            i = end;
+        }
+        return n;
+    }
+
+    static int decode_delta(const Reference& ref, const uint8_t* data, uint32_t len, uint8_t* out, uint32_t size)
+    {
+        uint32_t pos = 0;
+        uint32_t total = 0;
+        if (!get_varint(data, len, pos, total) || total > size) {
+            return -1;
+        }
+        auto base = [&](uint32_t i) -> uint8_t {
+            return i < ref.data.size() ? ref.data[i] : 0;
+        };
+        uint32_t i = 0;
+        while (i < total) {
+            uint32_t zeros = 0;
+            uint32_t lits = 0;
+            if (!get_varint(data, len, pos, zeros) || !get_varint(data, len, pos, lits)
+                || zeros > total - i || lits > total - i - zeros || lits > len - pos) {
+                return -1;
+            }
+            for (uint32_t end = i + zeros; i < end; ++i) {
+                out[i] = base(i);
+            }
+            for (uint32_t end = i + lits; i < end; ++i) {
+                out[i] = data[pos++] ^ base(i);
+            }
+        }
+        return pos == len ? (int)total : -1;
+    }
+
+    int control_topic_;
+    uint32_t key_interval_;
+    std::array<bool, 256> offered_ {};
+    std::array<std::atomic<bool>, 256> active_ {};
+    std::atomic<int64_t> accepted_until_ns_ { 0 };
+    std::atomic<uint32_t> epoch_ { 0 };
+
+    // tx state, strand only
+    std::array<Reference, 256> tx_ {};
+    uint32_t tx_epoch_ { 0 };
+    // rx state, rx context only
+    std::array<Reference, 256> rx_ {};
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_FRAME_CODEC_HPP__
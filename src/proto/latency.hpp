@@ -0,0 +1,194 @@
+#ifndef SYNAPSE_ROS_PROTO_LATENCY_HPP__
+#define SYNAPSE_ROS_PROTO_LATENCY_HPP__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Hot path latency instrumentation.
+//
+// Stages are stamped with the monotonic clock and recorded into lock-free
+// log-linear (HDR style) histograms per topic. Building without
+// SYNAPSE_ROS_LATENCY_STATS turns every call into a no-op.
+
+// TinyFrame types are one byte wide
+static constexpr std::size_t topic_count = 256;
+
+#ifdef SYNAPSE_ROS_LATENCY_STATS
+static constexpr bool latency_stats_enabled = true;
+#else
+static constexpr bool latency_stats_enabled = false;
+#endif
+
+inline int64_t latency_now()
+{
+    if constexpr (latency_stats_enabled) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    } else {
+        return 0;
+    }
+}
+
+enum class LatencyStage : uint8_t {
+    RxFrame, // datagram received -> TinyFrame frame complete
+    RxDecode, // frame complete -> protobuf parsed
+    RxPublish, // protobuf parsed -> published to ros
+    RxTotal, // datagram received -> published to ros
+    TxQueue, // ros callback -> frame encoded into the tx ring
+    TxSend, // frame encoded -> async_send_to completed
+    TxTotal, // ros callback -> async_send_to completed
+    Count,
+};
+
+static constexpr std::size_t latency_stage_count = (std::size_t)LatencyStage::Count;
+
+static constexpr const char* latency_stage_names[latency_stage_count] = {
+    "rx_frame", "rx_decode", "rx_publish", "rx_total", "tx_queue", "tx_send", "tx_total"
+};
+
+struct LatencySummary {
+    uint64_t count;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+};
+
+class LatencyHistogram {
+public:
+    // 16 linear sub-buckets per power of two, ~6% resolution up to ~1 min
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr int max_exponent = 36;
+    static constexpr std::size_t bucket_count = (max_exponent - sub_bucket_bits + 1) << sub_bucket_bits;
+
+    void record(int64_t ns)
+    {
+        uint64_t v = ns < 0 ? 0 : (uint64_t)ns;
+        buckets_[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (v > max && !max_.compare_exchange_weak(max, v, std::memory_order_relaxed)) { }
+    }
+
+    // summarize and reset, samples recorded concurrently land in either
+    // this window or the next one
+    LatencySummary drain()
+    {
+        std::array<uint64_t, bucket_count> counts;
+        uint64_t count = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+            count += counts[i];
+        }
+        uint64_t sum = sum_.exchange(0, std::memory_order_relaxed);
+        uint64_t max = max_.exchange(0, std::memory_order_relaxed);
+
+        LatencySummary summary {};
+        summary.count = count;
+        if (count == 0) {
+            return summary;
+        }
+        summary.mean_us = sum / 1e3 / count;
+        summary.p50_us = percentile(counts, count, 0.5) / 1e3;
+        summary.p99_us = percentile(counts, count, 0.99) / 1e3;
+        summary.p999_us = percentile(counts, count, 0.999) / 1e3;
+        summary.max_us = max / 1e3;
+        return summary;
+    }
+
+    static std::size_t bucket_of(uint64_t ns)
+    {
+        if (ns < (1u << sub_bucket_bits)) {
+            return ns;
+        }
+        int msb = 63 - __builtin_clzll(ns);
+        if (msb >= max_exponent) {
+            return bucket_count - 1;
+        }
+        int shift = msb - sub_bucket_bits;
+        std::size_t mantissa = (ns >> shift) & ((1u << sub_bucket_bits) - 1);
+        return ((std::size_t)(shift + 1) << sub_bucket_bits) + mantissa;
+    }
+
+    // lowest value that falls into bucket b
+    static uint64_t bucket_floor(std::size_t b)
+    {
+        if (b < (1u << sub_bucket_bits)) {
+            return b;
+        }
+        int shift = (int)(b >> sub_bucket_bits) - 1;
+        uint64_t mantissa = b & ((1u << sub_bucket_bits) - 1);
+        return ((1u << sub_bucket_bits) + mantissa) << shift;
+    }
+
+private:
+    static double percentile(const std::array<uint64_t, bucket_count>& counts, uint64_t count, double q)
+    {
+        uint64_t rank = (uint64_t)(q * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return (double)bucket_floor(i);
+            }
+        }
+        return (double)bucket_floor(bucket_count - 1);
+    }
+
+    std::array<std::atomic<uint64_t>, bucket_count> buckets_ {};
+    std::atomic<uint64_t> sum_ { 0 };
+    std::atomic<uint64_t> max_ { 0 };
+};
+
+// Histograms for every stage of the topics enabled at start up. Topics are
+// enabled before the io threads run, afterwards the table is read only.
+class LatencyStats {
+public:
+    struct Topic {
+        std::array<LatencyHistogram, latency_stage_count> stages;
+    };
+
+    void enable(int topic)
+    {
+        if constexpr (latency_stats_enabled) {
+            if (topic >= 0 && topic < (int)topic_count && !topics_[topic]) {
+                topics_[topic] = std::make_unique<Topic>();
+            }
+        }
+    }
+
+    void record(int topic, LatencyStage stage, int64_t start_ns, int64_t end_ns)
+    {
+        if constexpr (latency_stats_enabled) {
+            if (topic >= 0 && topic < (int)topic_count && topics_[topic]) {
+                topics_[topic]->stages[(std::size_t)stage].record(end_ns - start_ns);
+            }
+        } else {
+            (void)topic;
+            (void)stage;
+            (void)start_ns;
+            (void)end_ns;
+        }
+    }
+
+    Topic* topic(int topic) const
+    {
+        if (topic < 0 || topic >= (int)topic_count) {
+            return nullptr;
+        }
+        return topics_[topic].get();
+    }
+
+private:
+    std::array<std::unique_ptr<Topic>, topic_count> topics_ {};
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_LATENCY_HPP__
@@ -0,0 +1,670 @@
+#include <synapse_tinyframe/SynapseTopics.h>
+
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sys/socket.h>
+#endif
+
+#include "../link_bridge.hpp"
+#include "link.hpp"
+#include "serial_link.hpp"
+#include "tcp_link.hpp"
+#include "udp_link.hpp"
+
+using std::placeholders::_1;
+
+static void write_tf(TinyFrame* tf, const uint8_t* buf, uint32_t len)
+{
+    // get the link attached to tf pointer in userdata
+    Link* link = (Link*)tf->userdata;
+
+    // write buffer to the link
+    link->write(buf, len);
+}
+
+Link::Link(boost::asio::io_context& io_context, const LinkConfig& config, bool datagrams)
+    : config_(config)
+    , io_context_(io_context)
+    , strand_(boost::asio::make_strand(io_context))
+    , datagrams_(datagrams)
+    , tx_scheduler_(config.tx_schedule, config.tx_weights)
+    , tx_ring_(tx_slot_count_, std::max(config.tx_batch_bytes, tx_payload_length_ + tx_frame_overhead_))
+{
+    // priority class per topic, topics not listed are normal
+    tx_topic_class_.fill((uint8_t)TxClass::Normal);
+    for (int64_t topic : config_.tx_low_topics) {
+        if (topic >= 0 && topic < (int64_t)tx_topic_class_.size()) {
+            tx_topic_class_[topic] = (uint8_t)TxClass::Low;
+        }
+    }
+    for (int64_t topic : config_.tx_high_topics) {
+        if (topic >= 0 && topic < (int64_t)tx_topic_class_.size()) {
+            tx_topic_class_[topic] = (uint8_t)TxClass::High;
+        }
+    }
+
+    // Set up the TinyFrame library
+    tf_ = std::make_shared<TinyFrame>(*TF_Init(TF_MASTER, write_tf));
+    tf_->usertag = 0;
+    tf_->userdata = this;
+    tf_->write = write_tf;
+
+    TF_AddGenericListener(tf_.get(), Link::generic_listener);
+
+#ifndef __linux__
+    // recvmmsg and the busy poll thread are linux only, plain asio receives
+    // take over
+    if (config_.low_latency || config_.rx_batch > 1) {
+        log_.log(socket_log_, LogLevel::Warn, "low_latency and rx_batch need linux, using asio receives");
+    }
+    config_.rx_batch = 1;
+    config_.low_latency = false;
+#endif
+    config_.tx_class_inflight = std::max(config_.tx_class_inflight, 1u);
+    config_.rx_batch = std::max(config_.rx_batch, 1u);
+    config_.rx_buffers = std::max(config_.rx_buffers, 1u);
+    config_.rx_buf_size = std::max(config_.rx_buf_size, 64u);
+    rx_buf_.resize(std::max(config_.rx_batch, config_.rx_buffers) * rx_buffer_stride());
+
+    if (!config_.reliable_topics.empty()) {
+        reliable_ = std::make_unique<ReliableTx>(config_.reliable_topics, config_.reliable_timeout_ms, config_.reliable_retries);
+    }
+
+    if (!config_.codec_topics.empty()) {
+        codec_ = std::make_unique<FrameCodec>(config_.codec_control_topic, config_.codec_topics, config_.codec_key_interval);
+        rx_codec_buf_.resize(std::numeric_limits<TF_LEN>::max());
+    }
+
+    if (!config_.record_path.empty() && recorder_.open(config_.record_path, config_.record_size)) {
+        log_.log(recorder_log_, LogLevel::Info, "recording link traffic to %s", config_.record_path.c_str());
+    }
+}
+
+Link::~Link()
+{
+    rx_workers_.reset();
+    for (auto& queue : tx_queues_) {
+        delete queue.load(std::memory_order_acquire);
+    }
+}
+
+void Link::start()
+{
+    if (config_.rx_workers > 0) {
+        rx_workers_ = std::make_unique<RxWorkers>(config_.rx_workers, config_.rx_worker_queue_depth,
+            [this](int topic, const uint8_t* data, uint32_t len, int64_t rx_stamp) {
+                ros_->dispatch(topic, data, len, rx_stamp);
+            });
+    }
+    rx_start();
+    if (codec_) {
+        boost::asio::post(strand_, std::bind(&Link::codec_offer, this));
+    }
+}
+
+void Link::stop()
+{
+    rx_stop();
+    stopped_.store(true);
+    for (auto& slot : tx_queues_) {
+        if (MpscQueue<TxRequest>* queue = slot.load()) {
+            queue->close();
+        }
+    }
+}
+
+void Link::apply_socket_options(int fd)
+{
+#ifdef __linux__
+    if (config_.rcvbuf > 0) {
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config_.rcvbuf, sizeof(config_.rcvbuf)) != 0) {
+            log_.log(socket_log_, LogLevel::Warn, "failed to set SO_RCVBUF: %s", strerror(errno));
+        }
+    }
+    if (config_.sndbuf > 0) {
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &config_.sndbuf, sizeof(config_.sndbuf)) != 0) {
+            log_.log(socket_log_, LogLevel::Warn, "failed to set SO_SNDBUF: %s", strerror(errno));
+        }
+    }
+    if (config_.dscp >= 0) {
+        int tos = (config_.dscp & 0x3f) << 2;
+        if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+            log_.log(socket_log_, LogLevel::Warn, "failed to set IP_TOS: %s", strerror(errno));
+        }
+    }
+    if (config_.so_priority >= 0) {
+        if (setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &config_.so_priority, sizeof(config_.so_priority)) != 0) {
+            log_.log(socket_log_, LogLevel::Warn, "failed to set SO_PRIORITY: %s", strerror(errno));
+        }
+    }
+    if (config_.low_latency && config_.busy_poll_us > 0) {
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &config_.busy_poll_us, sizeof(config_.busy_poll_us)) != 0) {
+            log_.log(socket_log_, LogLevel::Warn, "failed to set SO_BUSY_POLL: %s", strerror(errno));
+        }
+    }
+#else
+    (void)fd;
+#endif
+}
+
+void Link::tx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
+{
+    int64_t now = latency_now();
+    TxRing::Slot* slot = tx_ring_.front();
+    latency_.record(slot->topic, LatencyStage::TxSend, slot->encoded_stamp, now);
+    latency_.record(slot->topic, LatencyStage::TxTotal, slot->queued_stamp, now);
+
+    if (!ec) {
+        stats_.add(LinkCounter::TxDatagrams);
+        stats_.add(LinkCounter::TxBytes, bytes_transferred);
+    }
+
+    // the slot in flight is no longer referenced by the socket
+    tx_ring_.release();
+    tx_busy_ = false;
+
+    if (ec == boost::asio::error::eof) {
+        stats_.add(LinkCounter::TxErrors);
+        log_.log(tx_error_log_, LogLevel::Warn, "reconnecting due to eof");
+    } else if (ec == boost::asio::error::connection_reset) {
+        stats_.add(LinkCounter::TxErrors);
+        log_.log(tx_error_log_, LogLevel::Warn, "reconnecting due to reset");
+    } else if (ec == boost::asio::error::not_connected) {
+        // stream transport between connections, the slot is dropped
+        stats_.add(LinkCounter::TxErrors);
+    } else if (ec != boost::system::errc::success) {
+        stats_.add(LinkCounter::TxErrors);
+        log_.log(tx_error_log_, LogLevel::Error, "tx error: %s", ec.message().c_str());
+    }
+
+    // refill the ring and send next queued frame
+    tx_drain();
+}
+
+void Link::log_rx_error(const boost::system::error_code& ec)
+{
+    stats_.add(LinkCounter::RxErrors);
+    if (ec == boost::asio::error::eof) {
+        log_.log(rx_error_log_, LogLevel::Warn, "reconnecting due to eof");
+    } else if (ec == boost::asio::error::connection_reset) {
+        log_.log(rx_error_log_, LogLevel::Warn, "reconnecting due to reset");
+    } else {
+        log_.log(rx_error_log_, LogLevel::Error, "rx error: %s", ec.message().c_str());
+    }
+}
+
+void Link::rx_accept(const uint8_t* buf, std::size_t len, bool truncated)
+{
+    // a partial frame would desync the TinyFrame parser, drop it instead
+    if (truncated) {
+        stats_.add(LinkCounter::RxTruncated);
+        log_.log(rx_truncated_log_, LogLevel::Warn, "rx datagram truncated, len:%zu rx_buf_size:%u",
+            len, config_.rx_buf_size);
+        rx_reset_parser();
+        return;
+    }
+    if (recorder_.is_open()) {
+        recorder_.record(RecordDirection::Rx, buf, len, recorder_now());
+    }
+    stats_.add(LinkCounter::RxDatagrams);
+    stats_.add(LinkCounter::RxBytes, len);
+
+    // TinyFrame silently resets on a bad CRC, a datagram that completes no
+    // frame is the only sign of it, a stream read may end mid frame
+    rx_datagram_frames_ = 0;
+    TF_Accept(tf_.get(), buf, len);
+    if (datagrams_ && rx_datagram_frames_ == 0) {
+        stats_.add(LinkCounter::RxFrameErrors);
+    }
+}
+
+TF_Result Link::generic_listener(TinyFrame* tf, TF_Msg* msg)
+{
+    // every frame lands here, the bridge dispatches by topic id in O(1)
+    Link* link = (Link*)tf->userdata;
+    LinkBridge* ros = link->ros_;
+    link->rx_datagram_frames_++;
+    link->stats_.rx_frame(msg->type);
+    if (link->codec_ && !link->codec_rx(msg)) {
+        return TF_STAY;
+    }
+    if (ros != NULL && msg->type == SYNAPSE_UPTIME_TOPIC && ros->uptime_received(msg->frame_id, msg->data, msg->len)) {
+        return TF_STAY;
+    }
+    if (ros != NULL && link->rx_workers_ && ros->handles(msg->type)) {
+        // the io thread only frames, decode and publish run on a worker
+        link->rx_workers_->push(msg->type, msg->data, msg->len, link->rx_stamp_);
+        return TF_STAY;
+    }
+    if (ros != NULL && ros->dispatch(msg->type, msg->data, msg->len, link->rx_stamp_)) {
+        return TF_STAY;
+    }
+
+    // not bridged, count it instead of dumping every frame
+    int type = msg->type;
+    if (type >= 0 && type < (int)link->unknown_frames_.size()
+        && link->unknown_frames_[type].fetch_add(1, std::memory_order_relaxed) == 0) {
+        link->log_.log(link->unknown_frame_log_, LogLevel::Info, "unhandled frame type:%d len:%d", type, (int)msg->len);
+    }
+    return TF_STAY;
+}
+
+bool Link::send(int topic, const uint8_t* data, uint32_t len, OverflowPolicy policy)
+{
+    if (len > tx_payload_length_ - tx_header_length(topic)) {
+        stats_.add(LinkCounter::TxEncodeErrors);
+        log_.log(tx_oversize_log_, LogLevel::Error, "tx payload too large, type:%d len:%u", topic, len);
+        return false;
+    }
+
+    return send_encoded(topic, policy, [&](uint8_t* buf, uint32_t size) {
+        (void)size;
+        memcpy(buf, data, len);
+        return (int)len;
+    });
+}
+
+void Link::stats(LinkStatsSnapshot& s) const
+{
+    stats_.snapshot(s);
+    s[LinkCounter::RxWorkerDrops] = rx_workers_ ? rx_workers_->dropped() : 0;
+    s[LinkCounter::RecorderDrops] = recorder_.dropped();
+    s[LinkCounter::LogDrops] = log_.dropped();
+    for (std::size_t c = 0; c < tx_class_count; ++c) {
+        s.tx_class[c].depth = 0;
+        for (std::size_t p = 0; p < overflow_policy_count; ++p) {
+            if (const MpscQueue<TxRequest>* queue = tx_queues_[c * overflow_policy_count + p].load(std::memory_order_acquire)) {
+                s.tx_class[c].depth += queue->size();
+            }
+        }
+    }
+}
+
+MpscQueue<Link::TxRequest>& Link::tx_queue(std::size_t cls, OverflowPolicy policy)
+{
+    std::atomic<MpscQueue<TxRequest>*>& slot = tx_queues_[cls * overflow_policy_count + (std::size_t)policy];
+    MpscQueue<TxRequest>* queue = slot.load(std::memory_order_acquire);
+    if (queue == NULL) {
+        // first frame of its kind, a producer losing the race frees its copy
+        auto created = std::make_unique<MpscQueue<TxRequest>>(config_.tx_queue_depth);
+        if (slot.compare_exchange_strong(queue, created.get(), std::memory_order_acq_rel)) {
+            queue = created.release();
+            // stop() may have missed the new queue
+            if (stopped_.load()) {
+                queue->close();
+            }
+        }
+    }
+    return *queue;
+}
+
+bool Link::tx_class_pending(std::size_t cls) const
+{
+    for (std::size_t p = 0; p < overflow_policy_count; ++p) {
+        const MpscQueue<TxRequest>* queue = tx_queues_[cls * overflow_policy_count + p].load(std::memory_order_acquire);
+        if (queue != NULL && !queue->empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MpscQueue<Link::TxRequest>* Link::tx_class_next(std::size_t cls)
+{
+    for (std::size_t i = 0; i < overflow_policy_count; ++i) {
+        std::size_t p = tx_queue_next_[cls];
+        tx_queue_next_[cls] = (p + 1) % overflow_policy_count;
+        MpscQueue<TxRequest>* queue = tx_queues_[cls * overflow_policy_count + p].load(std::memory_order_acquire);
+        if (queue != NULL && !queue->empty()) {
+            return queue;
+        }
+    }
+    return NULL;
+}
+
+void Link::tx_kick()
+{
+    // hand off to the io thread, only one wakeup is posted at a time
+    if (!tx_kick_pending_.exchange(true, std::memory_order_acq_rel)) {
+        boost::asio::post(strand_, [this]() {
+            tx_kick_pending_.exchange(false, std::memory_order_acq_rel);
+            tx_drain();
+        });
+    }
+}
+
+void Link::tx_drain()
+{
+    // encode queued payloads until the ring is full, tx_handler resumes
+    // draining once a slot is released
+    for (;;) {
+        // an open batch may have to be closed for the next frame, so it
+        // needs a second free slot behind it
+        std::size_t needed = (tx_slot_ != NULL && tx_slot_->len > 0) ? 2 : 1;
+        if (tx_ring_.available() < needed) {
+            break;
+        }
+        if (tx_slot_ == NULL) {
+            tx_slot_ = tx_ring_.acquire();
+        }
+
+        // below high priority only a few slots may be in flight, the rest
+        // waits in its queue where a high priority frame can overtake it
+        std::size_t inflight = tx_ring_.capacity() - tx_ring_.available();
+        int cls = tx_scheduler_.next([&](std::size_t c) {
+            return tx_class_pending(c) && (c == (std::size_t)TxClass::High || inflight < config_.tx_class_inflight);
+        });
+        MpscQueue<TxRequest>* queue = cls < 0 ? NULL : tx_class_next(cls);
+        if (queue == NULL) {
+            break;
+        }
+
+        // TF_Send calls write for each chunk of the frame, which is copied
+        // into the acquired slot so a frame never spans datagrams
+        bool popped = queue->try_pop([this, cls](TxRequest& req) {
+            stats_.tx_class_wait(cls, recorder_now() - req.queued_ns);
+            if (req.len < 0) {
+                return;
+            }
+            if (tx_slot_->len > 0 && tx_slot_->len + req.len + tx_frame_overhead_ > config_.tx_batch_bytes) {
+                tx_close_slot();
+                tx_slot_ = tx_ring_.acquire();
+            }
+            bool opened = tx_slot_->len == 0;
+
+            bool reliable = reliable_ && reliable_->reliable(req.topic);
+            uint32_t seq = 0;
+            if (reliable) {
+                seq = reliable_->next_seq();
+                ReliableTx::put_seq(req.data, seq);
+            }
+            const uint8_t* data = req.data;
+            uint32_t len = req.len;
+            if (codec_ && codec_->active(req.topic, recorder_now())) {
+                len = codec_->encode(req.topic, req.data, req.len, tx_codec_buf_, reliable);
+                data = tx_codec_buf_;
+                stats_.add(LinkCounter::TxCodecPlainBytes, req.len);
+                stats_.add(LinkCounter::TxCodecBytes, len);
+            }
+
+            TF_Msg frame;
+            TF_ClearMsg(&frame);
+            frame.type = req.topic;
+            frame.len = len;
+            frame.data = data;
+            tx_frame_begin();
+            TF_Send(tf_.get(), &frame);
+            if (!tx_frame_end()) {
+                return;
+            }
+            stats_.tx_frame(req.topic);
+            if (reliable) {
+                reliable_sent(seq, req.topic, data, len);
+            }
+
+            // time sync pings are stamped as they leave and never wait for
+            // a batch, the window would skew the round trip
+            bool ping = req.topic == SYNAPSE_UPTIME_TOPIC && ros_ != NULL;
+            if (ping) {
+                ros_->time_sync_sent(frame.frame_id);
+            }
+
+            int64_t now = latency_now();
+            latency_.record(req.topic, LatencyStage::TxQueue, req.stamp, now);
+            if (opened) {
+                tx_slot_->topic = req.topic;
+                tx_slot_->queued_stamp = req.stamp;
+                tx_slot_->encoded_stamp = now;
+            }
+
+            if (config_.tx_batch_window_us == 0 || ping) {
+                tx_close_slot();
+            } else if (opened && tx_slot_->len > 0) {
+                tx_batch_timer_.expires_after(std::chrono::microseconds(config_.tx_batch_window_us));
+                tx_batch_timer_.async_wait(std::bind(&Link::tx_batch_timeout, this, _1, tx_batch_gen_));
+            }
+        });
+        if (!popped) {
+            break;
+        }
+    }
+
+    if (!tx_busy_) {
+        tx_start();
+    }
+}
+
+void Link::tx_close_slot()
+{
+    if (tx_slot_ == NULL) {
+        return;
+    }
+    if (tx_slot_->len > 0) {
+        tx_ring_.commit();
+    }
+    tx_slot_ = NULL;
+    tx_batch_gen_++;
+}
+
+void Link::tx_batch_timeout(const boost::system::error_code& ec, uint32_t gen)
+{
+    // a stale timer belongs to a batch that was already closed by size
+    if (ec == boost::asio::error::operation_aborted || gen != tx_batch_gen_) {
+        return;
+    }
+    tx_close_slot();
+    tx_drain();
+}
+
+void Link::reliable_sent(uint32_t seq, int topic, const uint8_t* data, uint32_t len)
+{
+    if (!reliable_->sent(seq, topic, data, len, recorder_now())) {
+        stats_.add(LinkCounter::TxReliableFailed);
+        log_.log(reliable_log_, LogLevel::Warn, "frame seq:%u evicted an unacked frame", seq);
+    }
+    reliable_arm();
+}
+
+void Link::reliable_arm()
+{
+    if (reliable_timer_armed_ || reliable_->idle()) {
+        return;
+    }
+    reliable_timer_armed_ = true;
+    reliable_timer_.expires_at(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(reliable_->next_tick_ns())));
+    reliable_timer_.async_wait([this](const boost::system::error_code& ec) {
+        reliable_timer_armed_ = false;
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        reliable_->advance(
+            recorder_now(),
+            [this](uint32_t, const ReliableTx::Entry& e) { return tx_resend(e.topic, e.data.data(), e.data.size()); },
+            [this](uint32_t seq, const ReliableTx::Entry& e) {
+                stats_.add(LinkCounter::TxReliableFailed);
+                log_.log(reliable_log_, LogLevel::Error, "frame type:%d seq:%u not acked, giving up", e.topic, seq);
+            });
+        if (!tx_busy_) {
+            tx_start();
+        }
+        reliable_arm();
+    });
+}
+
+void Link::codec_offer()
+{
+    uint8_t offer[1 + 256];
+    uint32_t len = codec_->offer(offer, sizeof(offer));
+    send(codec_->control_topic(), offer, len, OverflowPolicy::DropOldest);
+
+    codec_timer_.expires_after(std::chrono::nanoseconds(FrameCodec::offer_period_ns));
+    codec_timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            codec_offer();
+        }
+    });
+}
+
+bool Link::codec_rx(TF_Msg* msg)
+{
+    // rx context, false if the frame was consumed or dropped
+    int64_t now = recorder_now();
+    if (msg->type == codec_->control_topic()) {
+        bool active = codec_->active(now);
+        if (!codec_->accept(msg->data, msg->len, now)) {
+            log_.log(codec_log_, LogLevel::Warn, "codec answer of unknown version, len:%d", (int)msg->len);
+        } else if (!active) {
+            log_.log(codec_log_, LogLevel::Info, "cerebri accepted payload encoding");
+        }
+        return false;
+    }
+    if (!codec_->active(msg->type, now)) {
+        return true;
+    }
+    int len = codec_->decode(msg->type, msg->data, msg->len, rx_codec_buf_.data(), rx_codec_buf_.size());
+    if (len < 0) {
+        stats_.add(LinkCounter::RxCodecErrors);
+        return false;
+    }
+    stats_.add(LinkCounter::RxCodecBytes, msg->len);
+    stats_.add(LinkCounter::RxCodecPlainBytes, len);
+    msg->data = rx_codec_buf_.data();
+    msg->len = len;
+    return true;
+}
+
+bool Link::reliable_ack(int seq, bool rejected)
+{
+    if (!reliable_ || !reliable_->ack((uint32_t)seq)) {
+        return false;
+    }
+    stats_.add(rejected ? LinkCounter::TxReliableRejected : LinkCounter::TxReliableAcked);
+    if (rejected) {
+        log_.log(reliable_log_, LogLevel::Warn, "frame seq:%u rejected by cerebri", (uint32_t)seq);
+    }
+    return true;
+}
+
+bool Link::tx_resend(int topic, const uint8_t* data, uint32_t len)
+{
+    // same room rule as tx_drain, an open batch needs a free slot behind it
+    std::size_t needed = (tx_slot_ != NULL && tx_slot_->len > 0) ? 2 : 1;
+    if (tx_ring_.available() < needed) {
+        return false;
+    }
+    if (tx_slot_ == NULL) {
+        tx_slot_ = tx_ring_.acquire();
+    }
+    if (tx_slot_->len > 0 && tx_slot_->len + len + tx_frame_overhead_ > config_.tx_batch_bytes) {
+        tx_close_slot();
+        tx_slot_ = tx_ring_.acquire();
+    }
+    if (tx_slot_->len == 0) {
+        int64_t now = latency_now();
+        tx_slot_->topic = topic;
+        tx_slot_->queued_stamp = now;
+        tx_slot_->encoded_stamp = now;
+    }
+
+    // the seq in the stored payload is what makes it a resend
+    TF_Msg frame;
+    TF_ClearMsg(&frame);
+    frame.type = topic;
+    frame.len = len;
+    frame.data = data;
+    tx_frame_begin();
+    TF_Send(tf_.get(), &frame);
+    if (!tx_frame_end()) {
+        tx_close_slot();
+        return true;
+    }
+    stats_.tx_frame(topic);
+    stats_.add(LinkCounter::TxRetransmits);
+
+    // a resend is late already, it does not wait for a batch
+    tx_close_slot();
+    return true;
+}
+
+void Link::tx_frame_begin()
+{
+    tx_frame_start_ = tx_slot_->len;
+    tx_frame_oversize_ = false;
+}
+
+bool Link::tx_frame_end()
+{
+    if (!tx_frame_oversize_) {
+        return true;
+    }
+    // a truncated frame would be garbage on the wire, drop all of it
+    tx_slot_->len = tx_frame_start_;
+    stats_.add(LinkCounter::TxEncodeErrors);
+    return false;
+}
+
+void Link::write(const uint8_t* buf, uint32_t len)
+{
+    if (tx_slot_ == NULL || tx_frame_oversize_) {
+        return;
+    }
+    if (tx_slot_->len + len > tx_ring_.slot_size()) {
+        log_.log(tx_oversize_log_, LogLevel::Error, "tx frame exceeds slot size, dropped");
+        tx_frame_oversize_ = true;
+        return;
+    }
+    memcpy(tx_slot_->data + tx_slot_->len, buf, len);
+    tx_slot_->len += len;
+}
+
+void Link::tx_start()
+{
+    TxRing::Slot* slot = tx_ring_.front();
+    if (slot == NULL) {
+        tx_busy_ = false;
+        return;
+    }
+
+    tx_busy_ = true;
+    if (recorder_.is_open()) {
+        recorder_.record(RecordDirection::Tx, slot->data, slot->len, recorder_now());
+    }
+    tx_write(slot->data, slot->len);
+}
+
+std::shared_ptr<Link> make_link(boost::asio::io_context& io_context, const LinkConfig& config)
+{
+    switch (config.transport) {
+    case LinkTransport::Tcp:
+        return std::make_shared<TCPLink>(io_context, config);
+    case LinkTransport::Serial:
+        return std::make_shared<SerialLink>(io_context, config);
+    case LinkTransport::Udp:
+        break;
+    }
+    return std::make_shared<UDPLink>(io_context, config);
+}
+
+bool parse_link_transport(const std::string& name, LinkTransport& transport)
+{
+    if (name == "udp") {
+        transport = LinkTransport::Udp;
+    } else if (name == "tcp") {
+        transport = LinkTransport::Tcp;
+    } else if (name == "serial") {
+        transport = LinkTransport::Serial;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,380 @@
+#ifndef SYNAPSE_ROS_PROTO_LINK_HPP__
+#define SYNAPSE_ROS_PROTO_LINK_HPP__
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "synapse_tinyframe/TinyFrame.h"
+
+#include "flight_recorder.hpp"
+#include "frame_codec.hpp"
+#include "latency.hpp"
+#include "link_stats.hpp"
+#include "log_ring.hpp"
+#include "mpsc_queue.hpp"
+#include "reliable_tx.hpp"
+#include "rx_workers.hpp"
+#include "tx_ring.hpp"
+#include "tx_scheduler.hpp"
+
+class LinkBridge;
+
+enum class LinkTransport {
+    Udp,
+    Tcp,
+    Serial,
+};
+
+struct LinkConfig {
+    LinkTransport transport { LinkTransport::Udp };
+    // udp / tcp endpoint of cerebri
+    std::string host { "192.0.2.1" };
+    int port { 4242 };
+    // local udp port to bind, 4242 unless set, 0 picks an ephemeral port
+    // (the default of named links, see SynapseRos::declare_link)
+    int local_port { 4242 };
+    // host lookups run in the background and are retried, starting after
+    // resolve_retry_ms and doubling up to resolve_retry_max_ms
+    uint32_t resolve_retry_ms { 100 };
+    uint32_t resolve_retry_max_ms { 5000 };
+    // serial device and baud rate
+    std::string device { "/dev/ttyUSB0" };
+    uint32_t baud { 921600 };
+
+    // depth of each priority class queue
+    uint32_t tx_queue_depth { 256 };
+    // topic ids sent in the high and low priority classes, the rest is
+    // normal, drained strictly by class or by weighted round robin
+    std::vector<int64_t> tx_high_topics {};
+    std::vector<int64_t> tx_low_topics {};
+    TxSchedule tx_schedule { TxSchedule::Strict };
+    std::vector<int64_t> tx_weights { 8, 4, 1 };
+    // tx ring slots the normal and low classes may fill ahead of the
+    // socket, a burst of them then never queues far ahead of a high
+    // priority frame
+    uint32_t tx_class_inflight { 4 };
+    // coalesce frames queued within this window into one write, 0 disables
+    uint32_t tx_batch_window_us { 0 };
+    // write size limit when coalescing, keep below the path MTU for udp
+    uint32_t tx_batch_bytes { 1472 };
+    // datagrams drained per rx wakeup with recvmmsg on linux, 1 disables
+    uint32_t rx_batch { 1 };
+    // receive buffer size, datagrams that fill it are assumed truncated and
+    // dropped, keep it above the largest datagram cerebri sends
+    uint32_t rx_buf_size { 2048 };
+    // udp receives kept in flight so the socket drains while a frame is parsed
+    uint32_t rx_buffers { 4 };
+    // decode and publish workers, 0 decodes inline on the io thread
+    uint32_t rx_workers { 0 };
+    // frames queued per worker before the oldest is dropped
+    uint32_t rx_worker_queue_depth { 256 };
+
+    // socket tuning, 0 / -1 keep the system defaults
+    int rcvbuf { 0 };
+    int sndbuf { 0 };
+    int dscp { -1 };
+    int so_priority { -1 };
+
+    // low latency mode (udp), a dedicated thread busy polls the socket
+    // instead of waiting for asio wakeups, optionally pinned to busy_poll_cpu
+    bool low_latency { false };
+    int busy_poll_us { 50 };
+    int busy_poll_cpu { -1 };
+
+    // capture every datagram (or stream read) into this mmap ring file,
+    // empty disables
+    std::string record_path {};
+    uint64_t record_size { 64 * 1024 * 1024 };
+
+    // topic ids sent with acknowledged delivery, acked through
+    // Status.request_seq, every other topic stays best effort
+    std::vector<int64_t> reliable_topics {};
+    // first resend after this, doubling per attempt
+    uint32_t reliable_timeout_ms { 20 };
+    uint32_t reliable_retries { 5 };
+
+    // topic ids offered for delta encoding, see FrameCodec, empty disables.
+    // The offer and cerebri's answer use codec_control_topic.
+    std::vector<int64_t> codec_topics {};
+    int codec_control_topic { 250 };
+    uint32_t codec_key_interval { 16 };
+};
+
+// Transport independent part of a cerebri link: TinyFrame, the tx queue,
+// ring and batching, acknowledged delivery, rx workers, recording, logging
+// and statistics. A transport only moves bytes: it starts its receive path
+// in rx_start(), hands what it reads to rx_accept() and writes one tx slot
+// at a time in tx_write(), completing it with tx_handler(), all on the
+// strand (or the udp busy poll thread for rx).
+class Link {
+protected:
+    LinkConfig config_;
+    boost::asio::io_context& io_context_;
+    // the io_context may be run by several threads, every handler of this
+    // link runs on the strand so TinyFrame and the buffers stay serialized
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+
+    // udp reads carry whole frames, a stream transport may split them
+    bool datagrams_;
+    int64_t rx_stamp_ { 0 };
+    uint32_t rx_datagram_frames_ { 0 };
+    FlightRecorder recorder_ {};
+
+    // rx, a ring of rx_buf_size buffers, one per outstanding receive or per
+    // datagram drained by recvmmsg, only touched from the strand (or the
+    // busy poll thread) so it needs no lock
+    std::vector<uint8_t> rx_buf_ {};
+    std::unique_ptr<RxWorkers> rx_workers_ {};
+
+    // tx, callbacks on any thread push serialized payloads into the queue
+    // of the topic's priority class and overflow policy, so a DropOldest
+    // burst only evicts frames of its own kind. The io thread drains the
+    // classes in scheduler order, the queues of a class in turn, and owns
+    // TinyFrame's tx state.
+    static const uint32_t tx_payload_length_ = 1024;
+    struct TxRequest {
+        uint8_t topic;
+        int32_t len; // -1 if encoding failed, the cell is skipped
+        int64_t stamp;
+        int64_t queued_ns; // steady clock, for the per class wait
+        uint8_t data[tx_payload_length_];
+    };
+    // created on first use, most links only ever use a few of them
+    std::array<std::atomic<MpscQueue<TxRequest>*>, tx_class_count * overflow_policy_count> tx_queues_ {};
+    std::array<std::size_t, tx_class_count> tx_queue_next_ {};
+    std::atomic<bool> stopped_ { false };
+    std::array<uint8_t, 256> tx_topic_class_ {};
+    TxScheduler tx_scheduler_;
+
+    // tx, frames are encoded once into the ring and owned until sent, when
+    // batching the slot at the head stays open until it is full or the
+    // batch window expires
+    static const uint32_t tx_slot_count_ = 64;
+    static const uint32_t tx_frame_overhead_ = 16;
+    TxRing tx_ring_;
+    TxRing::Slot* tx_slot_ { NULL };
+    boost::asio::steady_timer tx_batch_timer_ { strand_ };
+    uint32_t tx_batch_gen_ { 0 };
+    std::atomic<bool> tx_kick_pending_ { false };
+    // the frame TinyFrame is writing into tx_slot_, rolled back by
+    // tx_frame_end() if it does not fit the slot
+    uint32_t tx_frame_start_ { 0 };
+    bool tx_frame_oversize_ { false };
+    bool tx_busy_ { false };
+
+    // acknowledged delivery, only with reliable topics configured
+    std::unique_ptr<ReliableTx> reliable_ {};
+    boost::asio::steady_timer reliable_timer_ { strand_ };
+    bool reliable_timer_armed_ { false };
+
+    // payload encoding, only with codec topics configured, the offer is
+    // repeated from the strand for as long as the link runs
+    std::unique_ptr<FrameCodec> codec_ {};
+    boost::asio::steady_timer codec_timer_ { strand_ };
+    uint8_t tx_codec_buf_[tx_payload_length_ + FrameCodec::header_length];
+    std::vector<uint8_t> rx_codec_buf_ {};
+
+    // rate limits of the log sites on the hot path
+    LogLimit rx_error_log_ {};
+    LogLimit rx_truncated_log_ {};
+    LogLimit tx_error_log_ {};
+    LogLimit tx_oversize_log_ {};
+    LogLimit unknown_frame_log_ { 0 };
+    LogLimit reliable_log_ {};
+    LogLimit codec_log_ {};
+    LogLimit recorder_log_ {};
+
+    // frames received for topics the bridge does not handle, by type
+    std::array<std::atomic<uint64_t>, 256> unknown_frames_ {};
+
+    // background lookup of host:port, see resolve()
+    boost::asio::steady_timer resolve_timer_ { strand_ };
+    uint32_t resolve_retry_ms_ { 0 };
+    LogLimit resolve_log_ {};
+    // socket setup, once per (re)connect, every failure is worth a line
+    LogLimit socket_log_ { 0 };
+
+public:
+    LatencyStats latency_ {};
+    // deferred log messages, drained by the bridge
+    LogRing log_ {};
+    // health counters, the bridge adds the ones it sees (decode errors,
+    // throttling)
+    LinkStats stats_ {};
+
+    Link(const Link&) = delete;
+    Link& operator=(const Link&) = delete;
+    virtual ~Link();
+
+    // the bridge received frames are dispatched to and time sync pings are
+    // reported to, set before start()
+    void set_handler(LinkBridge* ros) { ros_ = ros; }
+    // start receiving, call once the owner is ready to dispatch frames
+    void start();
+    // shutdown, the io threads stop draining: the transport's own rx
+    // threads are joined, producers blocked on a full tx queue give up and
+    // later Block sends fail at once
+    void stop();
+    bool send(int topic, const uint8_t* data, uint32_t len, OverflowPolicy policy);
+
+    // encode(buf, size) serializes straight into the queued cell and returns
+    // the encoded length, or -1 if the payload could not be encoded
+    template <typename F>
+    bool send_encoded(int topic, OverflowPolicy policy, F&& encode)
+    {
+        int64_t stamp = latency_now();
+        int64_t queued_ns = recorder_now();
+        bool encoded = false;
+        uint32_t dropped = 0;
+        uint32_t header = tx_header_length(topic);
+        policy = tx_policy(topic, policy);
+        MpscQueue<TxRequest>& queue = tx_queue(tx_topic_class_[topic & 0xff], policy);
+        bool queued = queue.push([&](TxRequest& req) {
+            // the strand fills in the header once the frame leaves
+            int len = encode(req.data + header, tx_payload_length_ - header);
+            encoded = len >= 0;
+            req.topic = topic;
+            req.len = encoded ? header + len : -1;
+            req.stamp = stamp;
+            req.queued_ns = queued_ns;
+        },
+            policy, &dropped);
+        if (dropped > 0) {
+            stats_.add(LinkCounter::TxQueueDrops, dropped);
+        }
+        if (!queued) {
+            // a DropOldest queue that could not make room drops the new frame
+            stats_.add(policy == OverflowPolicy::DropOldest ? LinkCounter::TxQueueDrops : LinkCounter::TxQueueRejects);
+            return false;
+        }
+        if (!encoded) {
+            stats_.add(LinkCounter::TxEncodeErrors);
+            return false;
+        }
+        tx_kick();
+        return true;
+    }
+
+    void write(const uint8_t* buf, uint32_t len);
+
+    // Status.request_seq from cerebri, acks the reliable frame of that seq,
+    // false if none was waiting for it
+    bool reliable_ack(int seq, bool rejected);
+
+    // snapshot of stats_ including the counters owned by other stages
+    void stats(LinkStatsSnapshot& s) const;
+
+    uint64_t unknown_frames(int type) const
+    {
+        return unknown_frames_[type & 0xff].load(std::memory_order_relaxed);
+    }
+
+protected:
+    Link(boost::asio::io_context& io_context, const LinkConfig& config, bool datagrams);
+
+    // transport: begin receiving, called from start()
+    virtual void rx_start() = 0;
+    // transport: stop receiving threads of its own, called from stop()
+    virtual void rx_stop() { }
+    // transport: write len bytes of the slot at the tail, on the strand,
+    // tx_handler() must follow on the strand once the write completed
+    virtual void tx_write(const uint8_t* data, std::size_t len) = 0;
+
+    // feed received bytes to TinyFrame, truncated drops a datagram that
+    // did not fit its buffer
+    void rx_accept(const uint8_t* buf, std::size_t len, bool truncated);
+    // drop a partial frame, the stream was cut or a datagram lost bytes
+    void rx_reset_parser() { TF_ResetParser(tf_.get()); }
+    void tx_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
+    // one spare byte per buffer, a receive that cannot report MSG_TRUNC
+    // passes rx_buf_size + 1 and a datagram filling it is known to be cut
+    std::size_t rx_buffer_stride() const { return config_.rx_buf_size + 1; }
+    uint8_t* rx_buffer(std::size_t index) { return &rx_buf_[index * rx_buffer_stride()]; }
+    // buffer sizes, dscp and priority on a socket descriptor
+    void apply_socket_options(int fd);
+    void log_rx_error(const boost::system::error_code& ec);
+
+    // look up host:port without blocking, on_resolved(endpoint) runs on the
+    // strand with the first result, failures are logged and retried with
+    // backoff, so neither a slow nor a bad host stalls or aborts startup
+    template <typename Resolver, typename F>
+    void resolve(Resolver& resolver, F on_resolved)
+    {
+        resolver.async_resolve(config_.host, std::to_string(config_.port),
+            boost::asio::bind_executor(strand_,
+                [this, &resolver, on_resolved](const boost::system::error_code& ec,
+                    typename Resolver::results_type results) {
+                    if (!ec && !results.empty()) {
+                        resolve_retry_ms_ = 0;
+                        on_resolved(results.begin()->endpoint());
+                        return;
+                    }
+                    if (ec == boost::asio::error::operation_aborted) {
+                        return;
+                    }
+                    resolve_retry_ms_ = resolve_retry_ms_ == 0
+                        ? config_.resolve_retry_ms
+                        : std::min(resolve_retry_ms_ * 2, std::max(config_.resolve_retry_max_ms, config_.resolve_retry_ms));
+                    log_.log(resolve_log_, LogLevel::Warn, "failed to resolve %s:%d: %s, retrying in %u ms",
+                        config_.host.c_str(), config_.port, ec ? ec.message().c_str() : "no address",
+                        resolve_retry_ms_);
+                    resolve_timer_.expires_after(std::chrono::milliseconds(resolve_retry_ms_));
+                    resolve_timer_.async_wait([this, &resolver, on_resolved](const boost::system::error_code& ec) {
+                        if (ec != boost::asio::error::operation_aborted) {
+                            resolve(resolver, on_resolved);
+                        }
+                    });
+                }));
+    }
+
+private:
+    std::shared_ptr<TinyFrame> tf_ {};
+    LinkBridge* ros_ { NULL };
+
+    MpscQueue<TxRequest>& tx_queue(std::size_t cls, OverflowPolicy policy);
+    // strand: true if a frame of class cls is waiting, the queue to pop it
+    // from next or NULL
+    // reliable frames carry their seq in front of the payload
+    uint32_t tx_header_length(int topic) const
+    {
+        return reliable_ && reliable_->reliable(topic) ? ReliableTx::seq_length : 0;
+    }
+    // a reliable frame is never evicted unnoticed, it is rejected instead
+    // and waits in the class's Reject queue apart from streaming frames
+    OverflowPolicy tx_policy(int topic, OverflowPolicy policy) const
+    {
+        return policy == OverflowPolicy::DropOldest && reliable_ && reliable_->reliable(topic) ? OverflowPolicy::Reject : policy;
+    }
+    bool tx_class_pending(std::size_t cls) const;
+    MpscQueue<TxRequest>* tx_class_next(std::size_t cls);
+    void tx_kick();
+    void tx_drain();
+    void tx_close_slot();
+    void tx_frame_begin();
+    bool tx_frame_end();
+    void tx_batch_timeout(const boost::system::error_code& error, uint32_t gen);
+    void tx_start();
+    bool tx_resend(int topic, const uint8_t* data, uint32_t len);
+    void reliable_sent(uint32_t seq, int topic, const uint8_t* data, uint32_t len);
+    void reliable_arm();
+    void codec_offer();
+    bool codec_rx(TF_Msg* msg);
+
+    static TF_Result generic_listener(TinyFrame* tf, TF_Msg* msg);
+};
+
+// creates the transport selected by config.transport
+std::shared_ptr<Link> make_link(boost::asio::io_context& io_context, const LinkConfig& config);
+
+// "udp", "tcp" or "serial", false for anything else
+bool parse_link_transport(const std::string& name, LinkTransport& transport);
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_LINK_HPP__
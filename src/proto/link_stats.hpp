@@ -0,0 +1,190 @@
+#ifndef SYNAPSE_ROS_PROTO_LINK_STATS_HPP__
+#define SYNAPSE_ROS_PROTO_LINK_STATS_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "tx_scheduler.hpp"
+
+// Link health counters.
+//
+// Monotonic counts since the link was created, incremented with relaxed
+// atomics from whichever context sees the event (rx context, tx strand, rx
+// workers, subscription callbacks) and read as a snapshot by the periodic
+// statistics publisher, which derives rates from consecutive snapshots.
+// Every counter sits on its own cache line so rx and tx never share one.
+
+enum class LinkCounter : std::size_t {
+    RxDatagrams,
+    RxBytes,
+    RxFrames,
+    // datagrams that yielded no complete frame, bad CRC or garbage
+    RxFrameErrors,
+    RxTruncated,
+    RxErrors,
+    // frames whose protobuf payload failed to parse
+    RxDecodeErrors,
+    RxWorkerDrops,
+    // received before the lazy publisher of their topic existed
+    RxUnpublished,
+    TxFrames,
+    TxDatagrams,
+    TxBytes,
+    TxErrors,
+    TxEncodeErrors,
+    // dropped by a DropOldest queue to make room, or rejected when full
+    TxQueueDrops,
+    TxQueueRejects,
+    // not forwarded because of a max_rate / coalesce / on_change policy
+    TxThrottled,
+    // acknowledged delivery, resends, acks, rejects and frames given up on
+    TxRetransmits,
+    TxReliableAcked,
+    TxReliableRejected,
+    TxReliableFailed,
+    // payload encoding, bytes before and after the codec and frames that
+    // could not be decoded (a delta whose key was lost)
+    TxCodecPlainBytes,
+    TxCodecBytes,
+    RxCodecPlainBytes,
+    RxCodecBytes,
+    RxCodecErrors,
+    RecorderDrops,
+    LogDrops,
+    Count,
+};
+
+static constexpr std::size_t link_counter_count = (std::size_t)LinkCounter::Count;
+
+static constexpr const char* link_counter_names[link_counter_count] = {
+    "rx_datagrams",
+    "rx_bytes",
+    "rx_frames",
+    "rx_frame_errors",
+    "rx_truncated",
+    "rx_errors",
+    "rx_decode_errors",
+    "rx_worker_drops",
+    "rx_unpublished",
+    "tx_frames",
+    "tx_datagrams",
+    "tx_bytes",
+    "tx_errors",
+    "tx_encode_errors",
+    "tx_queue_drops",
+    "tx_queue_rejects",
+    "tx_throttled",
+    "tx_retransmits",
+    "tx_reliable_acked",
+    "tx_reliable_rejected",
+    "tx_reliable_failed",
+    "tx_codec_plain_bytes",
+    "tx_codec_bytes",
+    "rx_codec_plain_bytes",
+    "rx_codec_bytes",
+    "rx_codec_errors",
+    "recorder_drops",
+    "log_drops",
+};
+
+// counters that mean something was lost or broken, raise the diagnostic
+// level when they move
+static constexpr bool link_counter_is_error(LinkCounter c)
+{
+    return c == LinkCounter::RxFrameErrors || c == LinkCounter::RxTruncated || c == LinkCounter::RxErrors
+        || c == LinkCounter::RxDecodeErrors || c == LinkCounter::RxWorkerDrops || c == LinkCounter::TxErrors
+        || c == LinkCounter::TxEncodeErrors || c == LinkCounter::TxQueueDrops || c == LinkCounter::TxQueueRejects
+        || c == LinkCounter::TxReliableRejected || c == LinkCounter::TxReliableFailed
+        || c == LinkCounter::RxCodecErrors;
+}
+
+// per priority class, depth is sampled, wait_max_ns is the longest queue
+// wait since the previous snapshot
+struct TxClassSnapshot {
+    uint64_t depth { 0 };
+    uint64_t frames { 0 };
+    uint64_t wait_ns { 0 };
+    uint64_t wait_max_ns { 0 };
+};
+
+struct LinkStatsSnapshot {
+    std::array<uint64_t, link_counter_count> counters {};
+    std::array<TxClassSnapshot, tx_class_count> tx_class {};
+    // frames per topic id
+    std::array<uint64_t, 256> rx_topic {};
+    std::array<uint64_t, 256> tx_topic {};
+
+    uint64_t operator[](LinkCounter c) const { return counters[(std::size_t)c]; }
+    uint64_t& operator[](LinkCounter c) { return counters[(std::size_t)c]; }
+};
+
+class LinkStats {
+public:
+    void add(LinkCounter c, uint64_t n = 1)
+    {
+        counters_[(std::size_t)c].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // single rx context
+    void rx_frame(int topic)
+    {
+        add(LinkCounter::RxFrames);
+        rx_topic_[topic & 0xff].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // single tx strand
+    void tx_frame(int topic)
+    {
+        add(LinkCounter::TxFrames);
+        tx_topic_[topic & 0xff].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // single tx strand, a frame of class c left its queue after wait_ns
+    void tx_class_wait(std::size_t c, int64_t wait_ns)
+    {
+        TxClassCounters& counters = tx_class_[c];
+        uint64_t wait = wait_ns > 0 ? wait_ns : 0;
+        counters.frames.fetch_add(1, std::memory_order_relaxed);
+        counters.wait_ns.fetch_add(wait, std::memory_order_relaxed);
+        if (wait > counters.wait_max_ns.load(std::memory_order_relaxed)) {
+            counters.wait_max_ns.store(wait, std::memory_order_relaxed);
+        }
+    }
+
+    // single reader, resets the wait maxima
+    void snapshot(LinkStatsSnapshot& s) const
+    {
+        for (std::size_t c = 0; c < tx_class_count; ++c) {
+            s.tx_class[c].frames = tx_class_[c].frames.load(std::memory_order_relaxed);
+            s.tx_class[c].wait_ns = tx_class_[c].wait_ns.load(std::memory_order_relaxed);
+            s.tx_class[c].wait_max_ns = tx_class_[c].wait_max_ns.exchange(0, std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < link_counter_count; ++i) {
+            s.counters[i] = counters_[i].value.load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < s.rx_topic.size(); ++i) {
+            s.rx_topic[i] = rx_topic_[i].load(std::memory_order_relaxed);
+            s.tx_topic[i] = tx_topic_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(64) Counter {
+        std::atomic<uint64_t> value { 0 };
+    };
+    std::array<Counter, link_counter_count> counters_ {};
+    struct alignas(64) TxClassCounters {
+        std::atomic<uint64_t> frames { 0 };
+        std::atomic<uint64_t> wait_ns { 0 };
+        mutable std::atomic<uint64_t> wait_max_ns { 0 };
+    };
+    std::array<TxClassCounters, tx_class_count> tx_class_ {};
+    alignas(64) std::array<std::atomic<uint64_t>, 256> rx_topic_ {};
+    alignas(64) std::array<std::atomic<uint64_t>, 256> tx_topic_ {};
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_LINK_STATS_HPP__
@@ -0,0 +1,118 @@
+#ifndef SYNAPSE_ROS_PROTO_LOG_RING_HPP__
+#define SYNAPSE_ROS_PROTO_LOG_RING_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+
+#include "mpsc_queue.hpp"
+
+// Non-blocking logging for the io thread, rx workers and subscription
+// callbacks.
+//
+// A message is formatted into a preallocated cell of a lock-free queue and
+// written out later by the owner (the link bridge drains it from a ROS
+// timer), so a hot path never waits on terminal I/O. Every call site owns a
+// LogLimit that lets one message through per interval and counts the ones
+// it swallowed, the count is appended to the next message of that site. A
+// full queue drops the message and counts it as well.
+
+enum class LogLevel : uint8_t {
+    Info,
+    Warn,
+    Error,
+};
+
+class LogLimit {
+public:
+    explicit LogLimit(int64_t interval_ns = 1000000000)
+        : interval_ns_(interval_ns)
+    {
+    }
+
+    // true if the site may log at now_ns, suppressed is set to the number
+    // of messages swallowed since it last did
+    bool admit(int64_t now_ns, uint64_t& suppressed)
+    {
+        int64_t next = next_ns_.load(std::memory_order_relaxed);
+        if (now_ns < next || !next_ns_.compare_exchange_strong(next, now_ns + interval_ns_, std::memory_order_relaxed)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    int64_t interval_ns_;
+    std::atomic<int64_t> next_ns_ { 0 };
+    std::atomic<uint64_t> suppressed_ { 0 };
+};
+
+class LogRing {
+public:
+    static constexpr std::size_t text_length = 192;
+
+    struct Entry {
+        LogLevel level;
+        char text[text_length];
+    };
+
+    explicit LogRing(std::size_t depth = 64)
+        : queue_(depth)
+    {
+    }
+
+    // any thread, printf style, never blocks
+    void log(LogLimit& limit, LogLevel level, const char* fmt, ...) __attribute__((format(printf, 4, 5)))
+    {
+        uint64_t suppressed = 0;
+        if (!limit.admit(now_ns(), suppressed)) {
+            return;
+        }
+        va_list args;
+        va_start(args, fmt);
+        bool queued = queue_.try_push([&](Entry& entry) {
+            entry.level = level;
+            int n = vsnprintf(entry.text, text_length, fmt, args);
+            if (suppressed > 0 && n >= 0 && (std::size_t)n < text_length) {
+                snprintf(entry.text + n, text_length - n, " (%llu similar suppressed)", (unsigned long long)suppressed);
+            }
+        });
+        va_end(args);
+        if (!queued) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // single consumer, f(const Entry&) for every queued message
+    template <typename F>
+    std::size_t drain(F&& f)
+    {
+        std::size_t n = 0;
+        while (queue_.try_pop([&](Entry& entry) { f(entry); })) {
+            ++n;
+        }
+        return n;
+    }
+
+    // messages lost to a full queue
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    MpscQueue<Entry> queue_;
+    std::atomic<uint64_t> dropped_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_LOG_RING_HPP__
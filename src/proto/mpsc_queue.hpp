@@ -0,0 +1,192 @@
+#ifndef SYNAPSE_ROS_PROTO_MPSC_QUEUE_HPP__
+#define SYNAPSE_ROS_PROTO_MPSC_QUEUE_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// What a producer does when the queue is full.
+enum class OverflowPolicy {
+    DropOldest, // discard the oldest queued element, for streaming topics
+    Reject, // fail the push, the caller decides
+    Block, // wait a bounded time for the consumer to make room, for commands
+};
+
+static constexpr std::size_t overflow_policy_count = 3;
+
+// Bounded lock-free multi-producer queue with preallocated cells
+// (D. Vyukov's sequence-numbered ring). Elements are filled and consumed in
+// place through callbacks, so large fixed-size payloads are never copied
+// through temporaries. Pop is also safe from producers, which is what the
+// DropOldest policy relies on.
+template <typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(std::size_t capacity)
+        : mask_(round_up_pow2(capacity < 2 ? 2 : capacity) - 1)
+        , cells_(new Cell[mask_ + 1])
+    {
+        for (std::size_t i = 0; i <= mask_; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // longest a Block push waits for room before it is rejected
+    static constexpr int64_t block_timeout_ns = 100000000;
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    // no consumer will run again (shutdown), Block pushes stop waiting
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // approximate number of queued elements, for statistics
+    std::size_t size() const
+    {
+        std::size_t dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+        std::size_t enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? std::min(enqueue - dequeue, capacity()) : 0;
+    }
+
+    // consumer: true if no committed element is waiting, a push in
+    // progress is not seen yet
+    bool empty() const
+    {
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // fill(T&) is called on the reserved cell, returns false when full
+    template <typename F>
+    bool try_push(F&& fill)
+    {
+        Cell* cell;
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // push applying an overflow policy, returns false if the element was
+    // rejected, dropped counts elements discarded to make room. DropOldest
+    // never waits: only the oldest cell can make room, when a consumer is
+    // still working on it (or a producer still filling it) the new element
+    // is dropped instead, rather than draining the queue behind it. Block
+    // yields, then sleeps, for at most block_timeout_ns and gives up at
+    // once when the queue is closed.
+    template <typename F>
+    bool push(F&& fill, OverflowPolicy policy, uint32_t* dropped = nullptr)
+    {
+        uint32_t waits = 0;
+        std::chrono::steady_clock::time_point deadline {};
+        while (!try_push(fill)) {
+            switch (policy) {
+            case OverflowPolicy::Reject:
+                return false;
+            case OverflowPolicy::DropOldest:
+                if (head_consumed() || !try_pop([](T&) {})) {
+                    return false;
+                }
+                if (dropped != nullptr) {
+                    ++*dropped;
+                }
+                break;
+            case OverflowPolicy::Block:
+                if (closed()) {
+                    return false;
+                }
+                if (waits == 0) {
+                    deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(block_timeout_ns);
+                } else if (std::chrono::steady_clock::now() >= deadline) {
+                    return false;
+                }
+                // a short yield covers a consumer that is just draining,
+                // a stalled one is waited for without burning the core
+                if (++waits < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    // consume(T&) is called on the oldest cell, returns false when empty
+    template <typename F>
+    bool try_pop(F&& consume)
+    {
+        Cell* cell;
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        consume(cell->value);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // true if the cell the next push needs is still held by a consumer:
+    // committed in the previous lap and already past the dequeue position
+    bool head_consumed() const
+    {
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        std::size_t seq = cells_[pos & mask_].seq.load(std::memory_order_acquire);
+        return seq == pos - mask_ && dequeue_pos_.load(std::memory_order_relaxed) > pos - mask_ - 1;
+    }
+
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        T value;
+    };
+
+    static std::size_t round_up_pow2(std::size_t n)
+    {
+        std::size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<std::size_t> enqueue_pos_ { 0 };
+    alignas(64) std::atomic<std::size_t> dequeue_pos_ { 0 };
+    std::atomic<bool> closed_ { false };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_MPSC_QUEUE_HPP__
@@ -0,0 +1,183 @@
+#ifndef SYNAPSE_ROS_PROTO_RELIABLE_TX_HPP__
+#define SYNAPSE_ROS_PROTO_RELIABLE_TX_HPP__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Acknowledged delivery for command topics.
+//
+// Every reliable frame carries a 32 bit sequence number in front of its
+// payload, [seq (little endian)][payload], counted up per link across its
+// reliable topics. The frame id TinyFrame assigns is no use here, it is one
+// byte wide and shared with every streaming frame. The frame is kept until
+// cerebri reports its seq back in Status.request_seq, and resent with the
+// same seq when no ack arrives within the timeout, which doubles on every
+// attempt up to retries resends. cerebri suppresses duplicates by only
+// accepting a seq newer than the last one it accepted, and a periodic
+// status repeating an old request_seq finds no pending frame of that seq.
+//
+// Deadlines live in a hashed timer wheel advanced from one steady timer on
+// the link's strand, which only runs while frames are unacked. Everything
+// but ack() runs on the strand, ack() may be called from any thread.
+class ReliableTx {
+public:
+    static constexpr int64_t tick_ns = 5000000;
+    static constexpr std::size_t wheel_slots = 256;
+    // unacked frames, a newer seq evicts the frame capacity seqs before it
+    static constexpr std::size_t capacity = 256;
+    static constexpr uint32_t seq_length = 4;
+
+    struct Entry {
+        // seq << 8 | state, one word so an ack never hits a reused entry
+        std::atomic<uint64_t> tag { Free };
+        int topic { 0 };
+        uint32_t attempts { 0 };
+        uint64_t due_tick { 0 };
+        std::vector<uint8_t> data {};
+    };
+
+    ReliableTx(const std::vector<int64_t>& topics, uint32_t timeout_ms, uint32_t retries)
+        : timeout_ticks_(std::max<uint64_t>(1, (timeout_ms * 1000000ull + tick_ns - 1) / tick_ns))
+        , retries_(retries)
+    {
+        for (int64_t topic : topics) {
+            if (topic >= 0 && topic < (int64_t)topics_.size()) {
+                topics_[topic] = true;
+            }
+        }
+    }
+
+    bool reliable(int topic) const { return topics_[topic & 0xff]; }
+    bool idle() const { return pending_ == 0; }
+
+    // steady time the next tick is due, for arming the timer
+    int64_t next_tick_ns() const { return (int64_t)(tick_ + 1) * tick_ns; }
+
+    // strand: seq of the next reliable frame, never 0 (no request)
+    uint32_t next_seq()
+    {
+        if (++seq_ == 0) {
+            ++seq_;
+        }
+        return seq_;
+    }
+
+    static void put_seq(uint8_t* buf, uint32_t seq)
+    {
+        for (uint32_t i = 0; i < seq_length; ++i) {
+            buf[i] = seq >> (8 * i);
+        }
+    }
+
+    // strand: frame seq of topic left for the first time, false if it
+    // evicted an unacked frame
+    bool sent(uint32_t seq, int topic, const uint8_t* data, uint32_t len, int64_t now_ns)
+    {
+        Entry& e = entries_[seq % capacity];
+        uint8_t previous = e.tag.exchange(Free, std::memory_order_relaxed) & 0xff;
+        if (idle()) {
+            // the wheel stood still, resume it from now
+            tick_ = now_ns / tick_ns;
+        }
+        if (previous == Free) {
+            ++pending_;
+        }
+        bool evicted = previous == Pending;
+        e.topic = topic;
+        e.attempts = 0;
+        e.data.assign(data, data + len);
+        schedule(seq, e);
+        e.tag.store(tag(seq, Pending), std::memory_order_release);
+        return !evicted;
+    }
+
+    // any thread: cerebri processed seq, false if nothing was waiting for
+    // it (a repeated or late ack)
+    bool ack(uint32_t seq)
+    {
+        uint64_t expected = tag(seq, Pending);
+        return entries_[seq % capacity].tag.compare_exchange_strong(expected, tag(seq, Acked), std::memory_order_acq_rel);
+    }
+
+    // strand: run the wheel up to now_ns. resend(seq, const Entry&) returns
+    // false if the frame could not be queued, it is tried again next tick
+    // without counting an attempt. give_up(seq, const Entry&) is called
+    // once the retries are exhausted.
+    template <typename Resend, typename GiveUp>
+    void advance(int64_t now_ns, Resend&& resend, GiveUp&& give_up)
+    {
+        uint64_t now_tick = now_ns / tick_ns;
+        while (tick_ < now_tick && !idle()) {
+            ++tick_;
+            std::vector<uint32_t>& slot = wheel_[tick_ % wheel_slots];
+            expired_.swap(slot);
+            slot.clear();
+            for (uint32_t seq : expired_) {
+                Entry& e = entries_[seq % capacity];
+                uint64_t current = e.tag.load(std::memory_order_acquire);
+                if (e.due_tick != tick_ || (current >> 8) != seq) {
+                    // resent or evicted since, a later slot holds it
+                    continue;
+                }
+                uint8_t state = current & 0xff;
+                if (state == Acked) {
+                    release(e);
+                } else if (state == Pending && e.attempts >= retries_) {
+                    if (e.tag.compare_exchange_strong(current, Free, std::memory_order_acq_rel)) {
+                        --pending_;
+                        give_up(seq, (const Entry&)e);
+                    } else {
+                        release(e);
+                    }
+                } else if (state == Pending) {
+                    if (resend(seq, (const Entry&)e)) {
+                        ++e.attempts;
+                    }
+                    schedule(seq, e);
+                }
+            }
+            expired_.clear();
+        }
+    }
+
+private:
+    enum : uint8_t {
+        Free,
+        Pending,
+        Acked,
+    };
+
+    static uint64_t tag(uint32_t seq, uint8_t state) { return (uint64_t)seq << 8 | state; }
+
+    void schedule(uint32_t seq, Entry& e)
+    {
+        // doubling timeout, bounded by the span of the wheel
+        uint64_t delay = std::min<uint64_t>(timeout_ticks_ << std::min<uint32_t>(e.attempts, 16), wheel_slots - 1);
+        e.due_tick = tick_ + delay;
+        wheel_[e.due_tick % wheel_slots].push_back(seq);
+    }
+
+    void release(Entry& e)
+    {
+        e.tag.store(Free, std::memory_order_relaxed);
+        --pending_;
+    }
+
+    std::array<bool, 256> topics_ {};
+    uint64_t timeout_ticks_;
+    uint32_t retries_;
+
+    std::array<Entry, capacity> entries_ {};
+    std::array<std::vector<uint32_t>, wheel_slots> wheel_ {};
+    std::vector<uint32_t> expired_ {};
+    uint64_t tick_ { 0 };
+    uint32_t pending_ { 0 };
+    uint32_t seq_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_RELIABLE_TX_HPP__
@@ -0,0 +1,25 @@
+#ifndef SYNAPSE_ROS_PROTO_RX_ARENA_HPP__
+#define SYNAPSE_ROS_PROTO_RX_ARENA_HPP__
+
+#include <google/protobuf/arena.h>
+
+// Per-thread arena for rx decoding. Messages parsed from a received batch
+// are allocated on it and released together by reset_rx_arena(), so steady
+// state decoding reuses the initial block instead of calling malloc.
+static const size_t rx_arena_block_size = 16384;
+
+inline google::protobuf::Arena& rx_arena()
+{
+    thread_local char initial_block[rx_arena_block_size];
+    thread_local google::protobuf::Arena arena(initial_block, sizeof(initial_block));
+    return arena;
+}
+
+inline void reset_rx_arena()
+{
+    rx_arena().Reset();
+}
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_RX_ARENA_HPP__
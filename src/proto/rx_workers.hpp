@@ -0,0 +1,141 @@
+#ifndef SYNAPSE_ROS_PROTO_RX_WORKERS_HPP__
+#define SYNAPSE_ROS_PROTO_RX_WORKERS_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+#include "rx_arena.hpp"
+
+// Decode stage of the rx pipeline.
+//
+// The io thread only frames datagrams and hands complete frames over to a
+// small pool of workers which decode and publish them. Frames are sharded
+// by topic so every topic keeps its order and its publisher state is only
+// touched by one worker. Workers sleep on a condition variable when their
+// queue is empty, the producer only takes the lock to wake a sleeping one.
+class RxWorkers {
+public:
+    using Dispatch = std::function<void(int topic, const uint8_t* data, uint32_t len, int64_t rx_stamp)>;
+
+    RxWorkers(std::size_t workers, std::size_t queue_depth, Dispatch dispatch)
+        : dispatch_(std::move(dispatch))
+    {
+        for (std::size_t i = 0; i < workers; ++i) {
+            workers_.emplace_back(std::make_unique<Worker>(queue_depth));
+        }
+        for (auto& worker : workers_) {
+            worker->thread = std::thread(&RxWorkers::entry_point, this, worker.get());
+        }
+    }
+
+    ~RxWorkers()
+    {
+        for (auto& worker : workers_) {
+            {
+                const std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->running = false;
+            }
+            worker->cv.notify_one();
+            worker->thread.join();
+        }
+    }
+
+    // producer, called from the single rx context of the link. A full
+    // queue drops its oldest frame, stale samples are worth less than the
+    // socket falling behind, and never waits for the worker.
+    void push(int topic, const uint8_t* data, uint32_t len, int64_t rx_stamp)
+    {
+        Worker& worker = *workers_[topic % workers_.size()];
+        uint32_t dropped = 0;
+        bool queued = worker.queue.push([&](Frame& frame) {
+            frame.topic = topic;
+            frame.stamp = rx_stamp;
+            frame.data.assign(data, data + len);
+        },
+            OverflowPolicy::DropOldest, &dropped);
+        dropped += queued ? 0 : 1;
+        if (dropped > 0) {
+            dropped_.fetch_add(dropped, std::memory_order_relaxed);
+        }
+
+        // pairs with the fence in entry_point, either the worker sees the
+        // frame or the producer sees it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (worker.sleeping.load(std::memory_order_relaxed)) {
+            const std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.cv.notify_one();
+        }
+    }
+
+    // frames discarded because a worker fell behind
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Frame {
+        int topic;
+        int64_t stamp;
+        // grows to the largest frame of the shard once, then is reused
+        std::vector<uint8_t> data;
+    };
+
+    struct Worker {
+        explicit Worker(std::size_t queue_depth)
+            : queue(queue_depth)
+        {
+        }
+        MpscQueue<Frame> queue;
+        std::thread thread {};
+        std::mutex mutex {};
+        std::condition_variable cv {};
+        std::atomic<bool> sleeping { false };
+        bool running { true };
+    };
+
+    void entry_point(Worker* worker)
+    {
+        // the frame is swapped out so its cell is released before the
+        // decode and publish, a slow publish then never holds up the
+        // producer. The buffers only trade places, neither is reallocated.
+        Frame local { 0, 0, {} };
+        auto take = [&local](Frame& frame) {
+            local.topic = frame.topic;
+            local.stamp = frame.stamp;
+            local.data.swap(frame.data);
+        };
+
+        for (;;) {
+            while (worker->queue.try_pop(take)) {
+                dispatch_(local.topic, local.data.data(), local.data.size(), local.stamp);
+                reset_rx_arena();
+            }
+
+            worker->sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                while (worker->running && worker->queue.empty()) {
+                    worker->cv.wait(lock);
+                }
+                if (!worker->running) {
+                    return;
+                }
+            }
+            worker->sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    Dispatch dispatch_;
+    std::vector<std::unique_ptr<Worker>> workers_ {};
+    std::atomic<uint64_t> dropped_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_RX_WORKERS_HPP__
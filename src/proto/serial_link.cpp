@@ -0,0 +1,99 @@
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "rx_arena.hpp"
+#include "serial_link.hpp"
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+
+SerialLink::SerialLink(boost::asio::io_context& io_context, const LinkConfig& config)
+    : Link(io_context, config, false)
+    , port_(strand_)
+{
+}
+
+void SerialLink::rx_start()
+{
+    boost::asio::post(strand_, std::bind(&SerialLink::open, this));
+}
+
+void SerialLink::open()
+{
+    boost::system::error_code ec;
+    port_.open(config_.device, ec);
+    if (!ec) {
+        port_.set_option(boost::asio::serial_port::baud_rate(config_.baud), ec);
+    }
+    if (!ec) {
+        port_.set_option(boost::asio::serial_port::character_size(8), ec);
+        port_.set_option(boost::asio::serial_port::parity(boost::asio::serial_port::parity::none), ec);
+        port_.set_option(boost::asio::serial_port::stop_bits(boost::asio::serial_port::stop_bits::one), ec);
+        port_.set_option(boost::asio::serial_port::flow_control(boost::asio::serial_port::flow_control::none), ec);
+    }
+    if (ec) {
+        log_.log(rx_error_log_, LogLevel::Warn, "failed to open %s at %u baud: %s",
+            config_.device.c_str(), config_.baud, ec.message().c_str());
+        reopen();
+        return;
+    }
+    log_.log(rx_error_log_, LogLevel::Info, "opened %s at %u baud", config_.device.c_str(), config_.baud);
+    rx_read();
+}
+
+void SerialLink::rx_read()
+{
+    port_.async_read_some(boost::asio::buffer(rx_buffer(0), config_.rx_buf_size),
+        std::bind(&SerialLink::rx_handler, this, _1, _2));
+}
+
+void SerialLink::rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
+{
+    if (ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            log_rx_error(ec);
+        }
+        reopen();
+        return;
+    }
+
+    // a read may end mid frame, TinyFrame keeps the partial frame
+    rx_stamp_ = latency_now();
+    rx_accept(rx_buffer(0), bytes_transferred, false);
+    reset_rx_arena();
+    rx_read();
+}
+
+void SerialLink::reopen()
+{
+    // closing completes the pending read as aborted, which lands here again
+    if (reopening_) {
+        return;
+    }
+    reopening_ = true;
+    boost::system::error_code ec;
+    port_.close(ec);
+    rx_reset_parser();
+
+    reopen_timer_.expires_after(reopen_period_);
+    reopen_timer_.async_wait([this](const boost::system::error_code& ec) {
+        reopening_ = false;
+        if (ec != boost::asio::error::operation_aborted) {
+            open();
+        }
+    });
+}
+
+void SerialLink::tx_write(const uint8_t* data, std::size_t len)
+{
+    if (!port_.is_open()) {
+        // complete asynchronously, tx_handler drains the next slot
+        boost::asio::post(strand_, std::bind(&SerialLink::tx_handler, this,
+                                       boost::system::error_code(boost::asio::error::not_connected), 0));
+        return;
+    }
+    boost::asio::async_write(port_, boost::asio::buffer(data, len),
+        std::bind(&SerialLink::tx_handler, this, _1, _2));
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,36 @@
+#ifndef SYNAPSE_ROS_PROTO_SERIAL_LINK_HPP__
+#define SYNAPSE_ROS_PROTO_SERIAL_LINK_HPP__
+
+#include <boost/asio.hpp>
+#include <boost/asio/serial_port.hpp>
+
+#include "link.hpp"
+
+// UART transport (8N1, no flow control), e.g. for HIL benches. TinyFrame
+// reassembles frames from the byte stream, the device is reopened every
+// reopen_period_ after an error or while it is missing.
+class SerialLink : public Link {
+private:
+    static constexpr std::chrono::seconds reopen_period_ { 1 };
+
+    boost::asio::serial_port port_;
+    boost::asio::steady_timer reopen_timer_ { strand_ };
+    bool reopening_ { false };
+
+public:
+    SerialLink(boost::asio::io_context& io_context, const LinkConfig& config);
+
+protected:
+    void rx_start() override;
+    void tx_write(const uint8_t* data, std::size_t len) override;
+
+private:
+    void open();
+    void rx_read();
+    void rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred);
+    void reopen();
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_SERIAL_LINK_HPP__
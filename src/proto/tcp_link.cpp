@@ -0,0 +1,105 @@
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "rx_arena.hpp"
+#include "tcp_link.hpp"
+
+using boost::asio::ip::tcp;
+using std::placeholders::_1;
+using std::placeholders::_2;
+
+TCPLink::TCPLink(boost::asio::io_context& io_context, const LinkConfig& config)
+    : Link(io_context, config, false)
+    , sock_(strand_)
+    , resolver_(strand_)
+{
+}
+
+void TCPLink::rx_start()
+{
+    boost::asio::post(strand_, std::bind(&TCPLink::connect, this));
+}
+
+void TCPLink::connect()
+{
+    resolve(resolver_, [this](const tcp::endpoint& endpoint) {
+        remote_endpoint_ = endpoint;
+        sock_.async_connect(remote_endpoint_, std::bind(&TCPLink::connect_handler, this, _1));
+    });
+}
+
+void TCPLink::connect_handler(const boost::system::error_code& ec)
+{
+    if (ec) {
+        log_.log(rx_error_log_, LogLevel::Warn, "tcp connect to %s:%d failed: %s",
+            config_.host.c_str(), config_.port, ec.message().c_str());
+        disconnect();
+        return;
+    }
+
+    // frames are small and latency bound, never wait for Nagle
+    boost::system::error_code opt_ec;
+    sock_.set_option(tcp::no_delay(true), opt_ec);
+    apply_socket_options(sock_.native_handle());
+    connected_ = true;
+    log_.log(rx_error_log_, LogLevel::Info, "tcp connected to %s:%d", config_.host.c_str(), config_.port);
+    rx_read();
+}
+
+void TCPLink::rx_read()
+{
+    sock_.async_read_some(boost::asio::buffer(rx_buffer(0), config_.rx_buf_size),
+        std::bind(&TCPLink::rx_handler, this, _1, _2));
+}
+
+void TCPLink::rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
+{
+    if (ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            log_rx_error(ec);
+        }
+        disconnect();
+        return;
+    }
+
+    // a read may end mid frame, TinyFrame keeps the partial frame
+    rx_stamp_ = latency_now();
+    rx_accept(rx_buffer(0), bytes_transferred, false);
+    reset_rx_arena();
+    rx_read();
+}
+
+void TCPLink::disconnect()
+{
+    // closing completes the pending read as aborted, which lands here again
+    if (reconnecting_) {
+        return;
+    }
+    reconnecting_ = true;
+    boost::system::error_code ec;
+    sock_.close(ec);
+    connected_ = false;
+    rx_reset_parser();
+
+    reconnect_timer_.expires_after(reconnect_period_);
+    reconnect_timer_.async_wait([this](const boost::system::error_code& ec) {
+        reconnecting_ = false;
+        if (ec != boost::asio::error::operation_aborted) {
+            connect();
+        }
+    });
+}
+
+void TCPLink::tx_write(const uint8_t* data, std::size_t len)
+{
+    if (!connected_) {
+        // complete asynchronously, tx_handler drains the next slot
+        boost::asio::post(strand_, std::bind(&TCPLink::tx_handler, this,
+                                       boost::system::error_code(boost::asio::error::not_connected), 0));
+        return;
+    }
+    boost::asio::async_write(sock_, boost::asio::buffer(data, len),
+        std::bind(&TCPLink::tx_handler, this, _1, _2));
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,40 @@
+#ifndef SYNAPSE_ROS_PROTO_TCP_LINK_HPP__
+#define SYNAPSE_ROS_PROTO_TCP_LINK_HPP__
+
+#include <boost/asio.hpp>
+
+#include "link.hpp"
+
+// TCP client transport for wired links. TinyFrame reassembles frames from
+// the byte stream, a lost connection resets the parser and is retried
+// every reconnect_period_ while tx slots are dropped. The host is looked up
+// again before every connect, cerebri may come back under a new address.
+class TCPLink : public Link {
+private:
+    static constexpr std::chrono::seconds reconnect_period_ { 1 };
+
+    boost::asio::ip::tcp::socket sock_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::ip::tcp::endpoint remote_endpoint_;
+    boost::asio::steady_timer reconnect_timer_ { strand_ };
+    bool connected_ { false };
+    bool reconnecting_ { false };
+
+public:
+    TCPLink(boost::asio::io_context& io_context, const LinkConfig& config);
+
+protected:
+    void rx_start() override;
+    void tx_write(const uint8_t* data, std::size_t len) override;
+
+private:
+    void connect();
+    void connect_handler(const boost::system::error_code& ec);
+    void rx_read();
+    void rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred);
+    void disconnect();
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_TCP_LINK_HPP__
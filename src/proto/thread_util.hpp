@@ -0,0 +1,40 @@
+#ifndef SYNAPSE_ROS_PROTO_THREAD_UTIL_HPP__
+#define SYNAPSE_ROS_PROTO_THREAD_UTIL_HPP__
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Real-time settings for the calling thread. Both return false when the
+// platform does not support them or the process lacks the privilege
+// (CAP_SYS_NICE for SCHED_FIFO).
+
+inline bool pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+inline bool set_current_thread_fifo(int priority)
+{
+#ifdef __linux__
+    struct sched_param param {};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+    (void)priority;
+    return false;
+#endif
+}
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_THREAD_UTIL_HPP__
@@ -0,0 +1,101 @@
+#ifndef SYNAPSE_ROS_PROTO_TX_RING_HPP__
+#define SYNAPSE_ROS_PROTO_TX_RING_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Preallocated single-producer/single-consumer ring of frame buffers.
+//
+// The producer acquires the slot at the head, encodes a frame into it and
+// commits it. The consumer (the io thread) keeps the slot at the tail until
+// the asynchronous send completes and only then releases it, so the bytes
+// handed to the socket are never reused while in flight.
+class TxRing {
+public:
+    struct Slot {
+        uint32_t len;
+        uint8_t* data;
+        // first frame of the datagram, for latency stats
+        int topic;
+        int64_t queued_stamp;
+        int64_t encoded_stamp;
+    };
+
+    TxRing(std::size_t slot_count, std::size_t slot_size)
+        : mask_(round_up_pow2(slot_count) - 1)
+        , slot_size_(slot_size)
+        , storage_(new uint8_t[(mask_ + 1) * slot_size])
+        , slots_(new Slot[mask_ + 1])
+    {
+        for (std::size_t i = 0; i <= mask_; ++i) {
+            slots_[i].len = 0;
+            slots_[i].data = storage_.get() + i * slot_size_;
+        }
+    }
+
+    std::size_t slot_size() const { return slot_size_; }
+    std::size_t capacity() const { return mask_ + 1; }
+
+    // producer: number of slots not yet committed
+    std::size_t available() const
+    {
+        return mask_ + 1 - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+    }
+
+    // producer: returns the slot at the head, or nullptr if the ring is full
+    Slot* acquire()
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) {
+            return nullptr;
+        }
+        Slot* slot = &slots_[head & mask_];
+        slot->len = 0;
+        return slot;
+    }
+
+    // producer: publishes the slot returned by the last acquire()
+    void commit()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer: returns the oldest committed slot, or nullptr if empty
+    Slot* front()
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots_[tail & mask_];
+    }
+
+    // consumer: returns the slot obtained from front() to the producer
+    void release()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    static std::size_t round_up_pow2(std::size_t n)
+    {
+        std::size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    const std::size_t mask_;
+    const std::size_t slot_size_;
+    std::unique_ptr<uint8_t[]> storage_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::size_t> head_ { 0 };
+    alignas(64) std::atomic<std::size_t> tail_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_TX_RING_HPP__
@@ -0,0 +1,102 @@
+#ifndef SYNAPSE_ROS_PROTO_TX_SCHEDULER_HPP__
+#define SYNAPSE_ROS_PROTO_TX_SCHEDULER_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Priority classes of outbound frames.
+//
+// Every topic id maps to a class with its own tx queue, the strand picks
+// the next queue to drain with TxScheduler. Strict always serves the
+// highest class that has a frame waiting, weighted serves up to weight
+// frames of a class in turn (weighted round robin), so bulk classes keep a
+// share of the link under sustained high priority load.
+
+enum class TxClass : uint8_t {
+    High,
+    Normal,
+    Low,
+    Count,
+};
+
+static constexpr std::size_t tx_class_count = (std::size_t)TxClass::Count;
+
+static constexpr const char* tx_class_names[tx_class_count] = {
+    "high",
+    "normal",
+    "low",
+};
+
+enum class TxSchedule {
+    Strict,
+    Weighted,
+};
+
+// "strict" or "weighted", false for anything else
+inline bool parse_tx_schedule(const std::string& name, TxSchedule& schedule)
+{
+    if (name == "strict") {
+        schedule = TxSchedule::Strict;
+    } else if (name == "weighted") {
+        schedule = TxSchedule::Weighted;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// strand only
+class TxScheduler {
+public:
+    // weights by class, missing or zero weights count as 1
+    TxScheduler(TxSchedule schedule, const std::vector<int64_t>& weights)
+        : schedule_(schedule)
+    {
+        for (std::size_t c = 0; c < tx_class_count; ++c) {
+            weights_[c] = c < weights.size() ? (uint32_t)std::max<int64_t>(weights[c], 1) : 1;
+        }
+        credit_ = weights_;
+    }
+
+    // the class to pop from next, ready(c) tells whether class c may send,
+    // -1 if none may
+    template <typename Ready>
+    int next(Ready&& ready)
+    {
+        if (schedule_ == TxSchedule::Strict) {
+            for (std::size_t c = 0; c < tx_class_count; ++c) {
+                if (ready(c)) {
+                    return c;
+                }
+            }
+            return -1;
+        }
+
+        // a class that is idle or out of credit hands over to the next one
+        // and gets its full weight back for its next turn, the extra round
+        // comes back to the first class after a full cycle
+        for (std::size_t i = 0; i <= tx_class_count; ++i) {
+            if (credit_[current_] > 0 && ready(current_)) {
+                --credit_[current_];
+                return current_;
+            }
+            credit_[current_] = weights_[current_];
+            current_ = (current_ + 1) % tx_class_count;
+        }
+        return -1;
+    }
+
+private:
+    TxSchedule schedule_;
+    std::array<uint32_t, tx_class_count> weights_ {};
+    std::array<uint32_t, tx_class_count> credit_ {};
+    std::size_t current_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_PROTO_TX_SCHEDULER_HPP__
@@ -1,115 +1,180 @@
-#include <synapse_protobuf/nav_sat_fix.pb.h>
-#include <synapse_tinyframe/SynapseTopics.h>
-#include <synapse_tinyframe/utils.h>
-
-#include <synapse_protobuf/actuators.pb.h>
-#include <synapse_protobuf/odometry.pb.h>
-#include <synapse_protobuf/twist.pb.h>
-
 #include <boost/asio/error.hpp>
 #include <boost/system/error_code.hpp>
 
-#include "../synapse_ros.hpp"
+#include <cerrno>
+#include <cstring>
+
+#include "rx_arena.hpp"
+#include "thread_util.hpp"
 #include "udp_link.hpp"
 
 using boost::asio::ip::udp;
 using std::placeholders::_1;
 using std::placeholders::_2;
 
-static void write_udp(TinyFrame* tf, const uint8_t* buf, uint32_t len)
+UDPLink::UDPLink(boost::asio::io_context& io_context, const LinkConfig& config)
+    : Link(io_context, config, true)
+    , sock_(strand_, udp::endpoint(udp::v4(), config.local_port))
+    , resolver_(strand_)
 {
-    // get udp link attached to tf pointer in userdata
-    UDPLink* udp_link = (UDPLink*)tf->userdata;
+    my_endpoint_ = udp::endpoint(udp::v4(), config_.local_port);
 
-    // write buffer to udp link
-    udp_link->write(buf, len);
+    rx_endpoints_.resize(config_.rx_buffers);
+#ifdef __linux__
+    if (config_.rx_batch > 1) {
+        rx_msgs_.resize(config_.rx_batch);
+        rx_iov_.resize(config_.rx_batch);
+    }
+#endif
+
+    apply_socket_options(sock_.native_handle());
 }
 
-UDPLink::UDPLink(std::string host, int port)
+UDPLink::~UDPLink()
 {
-    remote_endpoint_ = *udp::resolver(io_context_).resolve(udp::resolver::query(host, std::to_string(port)));
-    my_endpoint_ = udp::endpoint(udp::v4(), 4242);
-
-    // Set up the TinyFrame library
-    tf_ = std::make_shared<TinyFrame>(*TF_Init(TF_MASTER, write_udp));
-    tf_->usertag = 0;
-    tf_->userdata = this;
-    tf_->write = write_udp;
-
-    TF_AddGenericListener(tf_.get(), UDPLink::generic_listener);
-    TF_AddTypeListener(tf_.get(), SYNAPSE_STATUS_TOPIC, UDPLink::status_listener);
-
-    // schedule new rx
-    sock_.async_receive_from(boost::asio::buffer(rx_buf_, rx_buf_length_),
-        my_endpoint_,
-        std::bind(&UDPLink::rx_handler, this, _1, _2));
+    rx_stop();
+    rx_workers_.reset();
 }
 
-void UDPLink::tx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
+void UDPLink::rx_stop()
 {
-    (void)bytes_transferred;
-    if (ec == boost::asio::error::eof) {
-        std::cerr << "reconnecting due to eof" << std::endl;
-    } else if (ec == boost::asio::error::connection_reset) {
-        std::cerr << "reconnecting due to reset" << std::endl;
-    } else if (ec != boost::system::errc::success) {
-        std::cerr << "tx error: " << ec.message() << std::endl;
+    // from the shutdown hook or the destructor, whichever comes first
+    if (rx_poll_running_.exchange(false)) {
+        rx_poll_thread_.join();
     }
 }
 
-void UDPLink::rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred)
+void UDPLink::rx_start()
 {
-    if (ec == boost::asio::error::eof) {
-        std::cerr << "reconnecting due to eof" << std::endl;
-    } else if (ec == boost::asio::error::connection_reset) {
-        std::cerr << "reconnecting due to reset" << std::endl;
-    } else if (ec != boost::system::errc::success) {
-        std::cerr << "rx error: " << ec.message() << std::endl;
-    } else if (ec == boost::system::errc::success) {
-        const std::lock_guard<std::mutex> lock(guard_rx_buf_);
-        TF_Accept(tf_.get(), rx_buf_, bytes_transferred);
+    // receiving only needs the local port, tx waits for the lookup
+    boost::asio::post(strand_, [this]() {
+        resolve(resolver_, [this](const udp::endpoint& endpoint) {
+            remote_endpoint_ = endpoint;
+            resolved_ = true;
+        });
+    });
+
+    if (config_.low_latency) {
+        rx_poll_running_ = true;
+        rx_poll_thread_ = std::thread(&UDPLink::rx_poll_entry_point, this);
+    } else {
+        boost::asio::post(strand_, std::bind(&UDPLink::rx_post, this));
     }
+}
 
-    // schedule new rx
-    sock_.async_receive_from(boost::asio::buffer(rx_buf_, rx_buf_length_),
-        my_endpoint_,
-        std::bind(&UDPLink::rx_handler, this, _1, _2));
+void UDPLink::rx_post()
+{
+    if (config_.rx_batch > 1) {
+        rx_wait();
+        return;
+    }
+
+    // keep every buffer of the ring posted, completions run in order on
+    // the strand while the kernel fills the next buffers
+    for (std::size_t i = 0; i < config_.rx_buffers; ++i) {
+        rx_receive(i);
+    }
 }
 
-TF_Result UDPLink::status_listener(TinyFrame* tf, TF_Msg* frame)
+void UDPLink::rx_poll_entry_point()
 {
-    // parse protobuf message
-    synapse::msgs::Status syn_msg;
-    if (!syn_msg.ParseFromArray(frame->data, frame->len)) {
-        std::cerr << "Failed to parse status" << std::endl;
-        return TF_STAY;
+#ifdef __linux__
+    if (config_.busy_poll_cpu >= 0 && !pin_current_thread(config_.busy_poll_cpu)) {
+        log_.log(socket_log_, LogLevel::Warn, "failed to pin busy poll thread to cpu %d", config_.busy_poll_cpu);
     }
 
-    // send to ros
-    UDPLink* udp_link = (UDPLink*)tf->userdata;
-    if (udp_link->ros_ != NULL) {
-        udp_link->ros_->publish_status(syn_msg);
+    // spin on a non-blocking receive. This thread runs TF_Accept while the
+    // strand runs TF_Send, which is safe only because TinyFrame's rx and tx
+    // fields are disjoint and TF_Send is only ever called on the strand, a
+    // change that sends from the rx path must post the send to the strand
+    int fd = sock_.native_handle();
+    while (rx_poll_running_.load(std::memory_order_relaxed)) {
+        // MSG_TRUNC returns the real datagram length
+        ssize_t n = ::recv(fd, rx_buffer(0), config_.rx_buf_size, MSG_DONTWAIT | MSG_TRUNC);
+        if (n > 0) {
+            rx_stamp_ = latency_now();
+            rx_accept(rx_buffer(0), n, (std::size_t)n > config_.rx_buf_size);
+            reset_rx_arena();
+        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stats_.add(LinkCounter::RxErrors);
+            log_.log(rx_error_log_, LogLevel::Error, "rx error: %s", strerror(errno));
+        }
     }
-    return TF_STAY;
+#endif
 }
 
-TF_Result UDPLink::generic_listener(TinyFrame* tf, TF_Msg* msg)
+void UDPLink::rx_handler(const boost::system::error_code& ec, std::size_t bytes_transferred, std::size_t index)
 {
-    (void)tf;
-    int type = msg->type;
-    std::cout << "generic listener id:" << type << std::endl;
-    dumpFrameInfo(msg);
-    return TF_STAY;
+    if (ec) {
+        log_rx_error(ec);
+    } else {
+        // asio does not report MSG_TRUNC, the receive got one spare byte so
+        // only a datagram larger than rx_buf_size reaches it
+        rx_stamp_ = latency_now();
+        rx_accept(rx_buffer(index), bytes_transferred, bytes_transferred > config_.rx_buf_size);
+        reset_rx_arena();
+    }
+
+    rx_receive(index);
+}
+
+void UDPLink::rx_batch_handler(const boost::system::error_code& ec)
+{
+#ifdef __linux__
+    if (ec != boost::system::errc::success) {
+        log_rx_error(ec);
+    } else {
+        // drain every datagram queued in the kernel with one syscall
+        for (uint32_t i = 0; i < config_.rx_batch; ++i) {
+            rx_iov_[i].iov_base = rx_buffer(i);
+            rx_iov_[i].iov_len = config_.rx_buf_size;
+            memset(&rx_msgs_[i], 0, sizeof(rx_msgs_[i]));
+            rx_msgs_[i].msg_hdr.msg_iov = &rx_iov_[i];
+            rx_msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = ::recvmmsg(sock_.native_handle(), rx_msgs_.data(), config_.rx_batch, MSG_DONTWAIT, NULL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            stats_.add(LinkCounter::RxErrors);
+            log_.log(rx_error_log_, LogLevel::Error, "rx error: %s", strerror(errno));
+        }
+
+        rx_stamp_ = latency_now();
+        for (int i = 0; i < n; ++i) {
+            rx_accept((const uint8_t*)rx_iov_[i].iov_base, rx_msgs_[i].msg_len,
+                (rx_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+        }
+        reset_rx_arena();
+    }
+#else
+    (void)ec;
+#endif
+
+    rx_wait();
 }
 
-void UDPLink::run_for(std::chrono::seconds sec)
+void UDPLink::rx_receive(std::size_t index)
 {
-    io_context_.run_for(std::chrono::seconds(sec));
+    sock_.async_receive_from(boost::asio::buffer(rx_buffer(index), rx_buffer_stride()),
+        rx_endpoints_[index],
+        std::bind(&UDPLink::rx_handler, this, _1, _2, index));
 }
 
-void UDPLink::write(const uint8_t* buf, uint32_t len)
+void UDPLink::rx_wait()
 {
-    sock_.async_send_to(boost::asio::buffer(buf, len),
+    sock_.async_wait(udp::socket::wait_read,
+        std::bind(&UDPLink::rx_batch_handler, this, _1));
+}
+
+void UDPLink::tx_write(const uint8_t* data, std::size_t len)
+{
+    if (!resolved_) {
+        // complete asynchronously, tx_handler drains the next slot
+        boost::asio::post(strand_, std::bind(&UDPLink::tx_handler, this,
+                                       boost::system::error_code(boost::asio::error::not_connected), 0));
+        return;
+    }
+    sock_.async_send_to(boost::asio::buffer(data, len),
         remote_endpoint_,
         std::bind(&UDPLink::tx_handler, this, _1, _2));
 }
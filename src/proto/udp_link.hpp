@@ -2,42 +2,55 @@
 #define SYNAPSE_ROS_PROTO_UDP_LINK_HPP__
 
 #include <boost/asio.hpp>
-#include <boost/asio/signal_set.hpp>
-#include <boost/date_time/posix_time/posix_time_config.hpp>
 
-#include "synapse_tinyframe/TinyFrame.h"
+#include <atomic>
+#include <thread>
 
-class SynapseRos;
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
 
-class UDPLink {
+#include "link.hpp"
+
+// UDP transport, one or more frames per datagram. Keeps several receives
+// in flight, optionally drains the socket with recvmmsg or busy polls it
+// from a dedicated thread in low latency mode.
+class UDPLink : public Link {
 private:
-    static const uint32_t rx_buf_length_ = 1024;
-    std::mutex guard_rx_buf_;
-    uint8_t rx_buf_[rx_buf_length_];
-    boost::asio::io_context io_context_ {};
-    boost::asio::ip::udp::socket sock_ {
-        boost::asio::ip::udp::socket(io_context_,
-            boost::asio::ip::udp::endpoint(
-                boost::asio::ip::udp::v4(), 4242))
-    };
+    boost::asio::ip::udp::socket sock_;
+    boost::asio::ip::udp::resolver resolver_;
     boost::asio::ip::udp::endpoint remote_endpoint_;
+    // tx fails with not_connected until the host is resolved
+    bool resolved_ { false };
     boost::asio::ip::udp::endpoint my_endpoint_;
 
+    // low latency rx, busy polling thread
+    std::thread rx_poll_thread_ {};
+    std::atomic<bool> rx_poll_running_ { false };
+
+    // sender of each outstanding receive
+    std::vector<boost::asio::ip::udp::endpoint> rx_endpoints_ {};
+#ifdef __linux__
+    std::vector<struct mmsghdr> rx_msgs_ {};
+    std::vector<struct iovec> rx_iov_ {};
+#endif
+
 public:
-    std::shared_ptr<TinyFrame> tf_ {};
-    SynapseRos* ros_ { NULL };
-    UDPLink(std::string host, int port);
-    void run_for(std::chrono::seconds sec);
-    void write(const uint8_t* buf, uint32_t len);
+    UDPLink(boost::asio::io_context& io_context, const LinkConfig& config);
+    ~UDPLink();
 
-private:
-    void timeout_handler();
-    void tx_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
-    void rx_handler(const boost::system::error_code& error, std::size_t bytes_transferred);
-    void send_frame(TF_Msg* msg);
+protected:
+    void rx_start() override;
+    void rx_stop() override;
+    void tx_write(const uint8_t* data, std::size_t len) override;
 
-    static TF_Result status_listener(TinyFrame* tf, TF_Msg* frame);
-    static TF_Result generic_listener(TinyFrame* tf, TF_Msg* msg);
+private:
+    void rx_handler(const boost::system::error_code& error, std::size_t bytes_transferred, std::size_t index);
+    void rx_batch_handler(const boost::system::error_code& error);
+    void rx_post();
+    void rx_receive(std::size_t index);
+    void rx_wait();
+    void rx_poll_entry_point();
 };
 
 // vi: ts=4 sw=4 et
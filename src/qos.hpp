@@ -0,0 +1,46 @@
+#ifndef SYNAPSE_ROS_QOS_HPP__
+#define SYNAPSE_ROS_QOS_HPP__
+
+#include <chrono>
+#include <cstddef>
+
+#include <rclcpp/rclcpp.hpp>
+
+// Per topic QoS, set from the qos.<topic>.* parameters.
+struct TopicQosConfig {
+    bool reliable { true };
+    std::size_t depth { 10 };
+    bool transient_local { false };
+    // 0 disables the deadline
+    double deadline_ms { 0 };
+};
+
+// high rate streams where only the newest sample matters, comparable to
+// rclcpp::SensorDataQoS with a history of one
+static const TopicQosConfig streaming_qos { false, 1, false, 0 };
+
+// state and acknowledgements that must not be lost
+static const TopicQosConfig reliable_qos { true, 10, false, 0 };
+
+inline rclcpp::QoS make_qos(const TopicQosConfig& config)
+{
+    rclcpp::QoS qos(config.depth);
+    if (config.reliable) {
+        qos.reliable();
+    } else {
+        qos.best_effort();
+    }
+    if (config.transient_local) {
+        qos.transient_local();
+    } else {
+        qos.durability_volatile();
+    }
+    if (config.deadline_ms > 0) {
+        qos.deadline(rclcpp::Duration(std::chrono::nanoseconds((int64_t)(config.deadline_ms * 1e6))));
+    }
+    return qos;
+}
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_QOS_HPP__
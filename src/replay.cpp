@@ -0,0 +1,126 @@
+// Replays a flight recorder capture into a running bridge.
+//
+// The cerebri -> ROS datagrams of the capture are sent to the bridge's
+// local port with their recorded spacing, so they take the same TinyFrame
+// parse, decode and publish path as live traffic. Point the bridge's host
+// at this tool (or anywhere, it only checks the port) and its local_port at
+// --port. With --speed 0 the capture is sent as fast as possible, which
+// makes it a load generator for reproducing throughput problems.
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "proto/flight_recorder.hpp"
+
+struct ReplayOptions {
+    std::string capture {};
+    std::string host { "127.0.0.1" };
+    int port { 4242 };
+    double speed { 1.0 };
+    bool loop { false };
+    bool tx { false };
+};
+
+static void usage()
+{
+    std::cerr << "usage: synapse_ros_replay <capture> [--host 127.0.0.1] [--port 4242]"
+              << " [--speed 1.0, 0 sends as fast as possible] [--loop] [--tx]" << std::endl
+              << "  --tx replays the ROS -> cerebri datagrams instead, e.g. into a simulator" << std::endl;
+}
+
+static bool parse_options(int argc, char** argv, ReplayOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            return i + 1 < argc ? argv[++i] : "";
+        };
+        if (arg == "--host") {
+            options.host = value();
+        } else if (arg == "--port") {
+            options.port = std::stoi(value());
+        } else if (arg == "--speed") {
+            options.speed = std::stod(value());
+        } else if (arg == "--loop") {
+            options.loop = true;
+        } else if (arg == "--tx") {
+            options.tx = true;
+        } else if (!arg.empty() && arg[0] != '-' && options.capture.empty()) {
+            options.capture = arg;
+        } else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return !options.capture.empty();
+}
+
+int main(int argc, char** argv)
+{
+    ReplayOptions options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    FlightRecording recording;
+    if (!recording.open(options.capture)) {
+        return 1;
+    }
+    if (recording.dropped() > 0) {
+        std::cerr << "capture dropped " << recording.dropped() << " datagrams while recording" << std::endl;
+    }
+
+    boost::asio::io_context io_context;
+    boost::asio::ip::udp::socket sock(io_context, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0));
+    boost::asio::ip::udp::endpoint remote = *boost::asio::ip::udp::resolver(io_context).resolve(
+        boost::asio::ip::udp::resolver::query(options.host, std::to_string(options.port)));
+
+    RecordDirection direction = options.tx ? RecordDirection::Tx : RecordDirection::Rx;
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        auto pass_start = std::chrono::steady_clock::now();
+        int64_t first_stamp = -1;
+        recording.for_each([&](const RecordHeader& record, const uint8_t* payload) {
+            if (record.direction != direction) {
+                return;
+            }
+            if (first_stamp < 0) {
+                first_stamp = record.stamp_ns;
+            }
+            if (options.speed > 0) {
+                auto due = pass_start + std::chrono::nanoseconds((int64_t)((record.stamp_ns - first_stamp) / options.speed));
+                std::this_thread::sleep_until(due);
+            }
+            boost::system::error_code ec;
+            sock.send_to(boost::asio::buffer(payload, record.len), remote, 0, ec);
+            if (ec) {
+                std::cerr << "send failed: " << ec.message() << std::endl;
+                return;
+            }
+            ++sent;
+            bytes += record.len;
+        });
+        if (first_stamp < 0) {
+            std::cerr << "capture holds no " << (options.tx ? "tx" : "rx") << " datagrams" << std::endl;
+            return 1;
+        }
+    } while (options.loop);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "sent " << sent << " datagrams, " << bytes << " bytes in " << elapsed << " s";
+    if (elapsed > 0) {
+        std::cout << ", " << sent / elapsed << " datagrams/s";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+// vi: ts=4 sw=4 et
@@ -1,146 +1,365 @@
 #include "synapse_ros.hpp"
-#include "proto/udp_link.hpp"
+#include "proto/thread_util.hpp"
 
 #include <rclcpp/logger.hpp>
-#include <sensor_msgs/msg/detail/joint_state__struct.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
 
-using std::placeholders::_1;
-std::shared_ptr<UDPLink> g_udp_link { NULL };
-
-void udp_entry_point()
+static OverflowPolicy parse_overflow_policy(const rclcpp::Logger& logger, const std::string& name)
 {
-    while (rclcpp::ok()) {
-        g_udp_link->run_for(std::chrono::seconds(1));
+    if (name == "drop_oldest") {
+        return OverflowPolicy::DropOldest;
+    } else if (name == "reject") {
+        return OverflowPolicy::Reject;
+    } else if (name == "block") {
+        return OverflowPolicy::Block;
     }
+    RCLCPP_WARN(logger, "unknown overflow policy '%s', using reject", name.c_str());
+    return OverflowPolicy::Reject;
 }
 
-SynapseRos::SynapseRos()
-    : Node("synapse_ros")
+SynapseRos::SynapseRos(const rclcpp::NodeOptions& options)
+    : Node("synapse_ros", options)
 {
-    this->declare_parameter("host", "192.0.2.1");
-    this->declare_parameter("port", 4242);
+    // settings shared by all links
+    this->declare_parameter("links", std::vector<std::string> {});
+    this->declare_parameter("io_threads", 1);
+    this->declare_parameter("io_cpus", std::vector<int64_t> {});
+    this->declare_parameter("io_priority", 0);
+    this->declare_parameter("tx_queue_depth", 256);
+    this->declare_parameter("tx_schedule", "strict");
+    this->declare_parameter("tx_weights", std::vector<int64_t> { 8, 4, 1 });
+    this->declare_parameter("tx_class_inflight", 4);
+    this->declare_parameter("tx_batch_window_us", 0);
+    this->declare_parameter("tx_batch_bytes", 1472);
+    this->declare_parameter("rx_batch", 1);
+    this->declare_parameter("rx_buf_size", 2048);
+    this->declare_parameter("rx_buffers", 4);
+    this->declare_parameter("rx_workers", 0);
+    this->declare_parameter("rx_worker_queue_depth", 256);
+    this->declare_parameter("socket_rcvbuf", 0);
+    this->declare_parameter("socket_sndbuf", 0);
+    this->declare_parameter("dscp", -1);
+    this->declare_parameter("socket_priority", -1);
+    this->declare_parameter("low_latency", false);
+    this->declare_parameter("busy_poll_us", 50);
+    this->declare_parameter("busy_poll_cpu", -1);
+    this->declare_parameter("clock_sync", true);
+    this->declare_parameter("time_sync_period", 0.0);
+    this->declare_parameter("record_size", 64 * 1024 * 1024);
+    this->declare_parameter("reliable_timeout_ms", 20);
+    this->declare_parameter("reliable_retries", 5);
+    this->declare_parameter("codec_control_topic", 250);
+    this->declare_parameter("codec_key_interval", 16);
+    this->declare_parameter("joy.overflow_policy", "drop_oldest");
+    this->declare_parameter("road_curve_angle.overflow_policy", "drop_oldest");
+    this->declare_parameter("raw.overflow_policy", "drop_oldest");
+    for (const char* topic : { "joy", "road_curve_angle" }) {
+        this->declare_parameter(std::string(topic) + ".max_rate", 0.0);
+        this->declare_parameter(std::string(topic) + ".coalesce", false);
+        this->declare_parameter(std::string(topic) + ".on_change", false);
+    }
+    this->declare_parameter("latency_stats_period", 5.0);
+    this->declare_parameter("stats_period", 1.0);
+    // see LinkBridgeConfig::lazy_publishers, drops up to 100 ms of each
+    // topic's first frames
+    this->declare_parameter("lazy_publishers", false);
+    this->declare_parameter("resolve_retry_ms", 100);
+    this->declare_parameter("resolve_retry_max_ms", 5000);
+    this->declare_parameter("realtime_topics", std::vector<std::string> { "joy" });
+    this->declare_parameter("realtime_cpu", -1);
+    this->declare_parameter("realtime_priority", 0);
 
-    std::string host = this->get_parameter("host").as_string();
-    int port = this->get_parameter("port").as_int();
+    // qos per bridged topic, streams default to best effort with depth 1
+    declare_qos("joy", streaming_qos);
+    declare_qos("road_curve_angle", streaming_qos);
+    declare_qos("status", reliable_qos);
+    declare_qos("uptime", streaming_qos);
+    declare_qos("clock_offset", streaming_qos);
+    declare_qos("raw", reliable_qos);
 
-    // subscriptions ros -> cerebri
+    std::vector<std::string> links = this->get_parameter("links").as_string_array();
+    int io_threads = this->get_parameter("io_threads").as_int();
+    io_cpus_ = this->get_parameter("io_cpus").as_integer_array();
+    io_priority_ = this->get_parameter("io_priority").as_int();
+    double latency_stats_period = this->get_parameter("latency_stats_period").as_double();
+    double stats_period = this->get_parameter("stats_period").as_double();
+    realtime_cpu_ = this->get_parameter("realtime_cpu").as_int();
+    realtime_priority_ = this->get_parameter("realtime_priority").as_int();
 
-    sub_joy_ = this->create_subscription<sensor_msgs::msg::Joy>(
-        "in/joy", 10, std::bind(&SynapseRos::joy_callback, this, _1));
+    if (links.empty()) {
+        // single board, topics directly in the node namespace
+        links_.push_back(std::make_shared<LinkBridge>(this, io_context_, declare_link("", "")));
+    } else {
+        for (const auto& name : links) {
+            std::string prefix = this->declare_parameter(name + ".namespace", name);
+            links_.push_back(std::make_shared<LinkBridge>(this, io_context_, declare_link(name, prefix)));
+        }
+    }
 
-    sub_road_curve_angle_ = this->create_subscription<synapse_msgs::msg::RoadCurveAngle>(
-        "in/road_curve_angle", 10, std::bind(&SynapseRos::road_curve_angle_callback, this, _1));
+    // latency histograms (only when compiled in) and link statistics
+    if ((latency_stats_enabled && latency_stats_period > 0) || stats_period > 0) {
+        pub_diagnostics_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("out/diagnostics", 10);
+    }
+    if (latency_stats_enabled && latency_stats_period > 0) {
+        diagnostics_timer_ = this->create_wall_timer(
+            std::chrono::duration<double>(latency_stats_period),
+            std::bind(&SynapseRos::publish_diagnostics, this));
+    }
+    if (stats_period > 0) {
+        stats_timer_ = this->create_wall_timer(
+            std::chrono::duration<double>(stats_period),
+            std::bind(&SynapseRos::publish_link_stats, this));
+    }
+
+    // latency critical subscriptions on their own executor thread
+    for (auto& link : links_) {
+        for (auto& group : link->realtime_groups()) {
+            if (!realtime_executor_) {
+                realtime_executor_ = std::make_unique<rclcpp::executors::SingleThreadedExecutor>();
+            }
+            realtime_executor_->add_callback_group(group, this->get_node_base_interface());
+        }
+    }
 
-    // publications cerebri -> ros
+    // stop the io loop as soon as rclcpp shuts down instead of polling
+    shutdown_handle_ = this->get_node_base_interface()->get_context()->add_on_shutdown_callback(
+        [this]() {
+            realtime_stop();
+            io_stop();
+        });
 
-    pub_status_ = this->create_publisher<synapse_msgs::msg::Status>("out/status", 10);
+    if (realtime_executor_) {
+        realtime_thread_ = std::thread(&SynapseRos::realtime_entry_point, this);
+    }
 
-    // create udp link
-    g_udp_link = std::make_shared<UDPLink>(host, port);
-    g_udp_link.get()->ros_ = this;
-    tf_ = g_udp_link.get()->tf_;
-    udp_thread_ = std::make_shared<std::thread>(udp_entry_point);
+    for (int i = 0; i < std::max(io_threads, 1); ++i) {
+        io_threads_.emplace_back(&SynapseRos::io_entry_point, this, i);
+    }
 }
 
 SynapseRos::~SynapseRos()
 {
-    // join threads
-    udp_thread_->join();
+    // join threads, the component may be unloaded while rclcpp is still ok
+    this->get_node_base_interface()->get_context()->remove_on_shutdown_callback(shutdown_handle_);
+    realtime_stop();
+    if (realtime_thread_.joinable()) {
+        realtime_thread_.join();
+    }
+    io_stop();
+    for (auto& thread : io_threads_) {
+        thread.join();
+    }
 }
 
-std_msgs::msg::Header SynapseRos::compute_header(const synapse::msgs::Header& msg)
+void SynapseRos::io_stop()
 {
-    std_msgs::msg::Header ros_msg;
-    ros_msg.frame_id = msg.frame_id();
-    if (msg.has_stamp()) {
-        int64_t sec = msg.stamp().sec() + ros_clock_offset_.sec;
-        int64_t nanos = msg.stamp().nanosec() + ros_clock_offset_.nanosec;
-        int extra_sec = nanos / 1e9;
-        nanos -= extra_sec * 1e9;
-        sec += extra_sec;
-        ros_msg.stamp.sec = sec;
-        ros_msg.stamp.nanosec = nanos;
-    }
-    return ros_msg;
+    // nothing drains the tx queues afterwards, release blocked producers
+    for (auto& link : links_) {
+        link->stop();
+    }
+    io_work_.reset();
+    io_context_.stop();
 }
 
-void SynapseRos::publish_status(const synapse::msgs::Status& msg)
+void SynapseRos::realtime_stop()
 {
-    synapse_msgs::msg::Status ros_msg;
-
-    // header
-    if (msg.has_header()) {
-        ros_msg.header = compute_header(msg.header());
+    realtime_stop_ = true;
+    if (realtime_executor_) {
+        realtime_executor_->cancel();
     }
-
-    ros_msg.arming = msg.arming();
-    ros_msg.fuel = msg.fuel();
-    ros_msg.joy = msg.joy();
-    ros_msg.mode = msg.mode();
-    ros_msg.safety = msg.safety();
-    ros_msg.fuel_percentage = msg.fuel_percentage();
-    ros_msg.power = msg.power();
-    ros_msg.status_message = msg.status_message();
-    ros_msg.request_rejected = msg.request_rejected();
-    ros_msg.request_seq = msg.request_seq();
-
-    pub_status_->publish(ros_msg);
 }
 
-void SynapseRos::joy_callback(const sensor_msgs::msg::Joy& msg) const
+void SynapseRos::realtime_entry_point()
 {
-    synapse::msgs::Joy syn_msg;
-    for (auto i = 0u; i < msg.axes.size(); ++i) {
-        syn_msg.add_axes(msg.axes[i]);
+    if (realtime_cpu_ >= 0 && !pin_current_thread(realtime_cpu_)) {
+        RCLCPP_WARN(this->get_logger(), "failed to pin realtime executor thread to cpu %d", realtime_cpu_);
+    }
+    if (realtime_priority_ > 0 && !set_current_thread_fifo(realtime_priority_)) {
+        RCLCPP_WARN(this->get_logger(), "failed to set SCHED_FIFO priority %d on realtime executor thread",
+            realtime_priority_);
     }
 
-    for (auto i = 0u; i < msg.buttons.size(); ++i) {
-        syn_msg.add_buttons(msg.buttons[i]);
+    // spin_once rather than spin, a cancel() that lands before spin() would
+    // otherwise be lost and the thread never joins
+    while (!realtime_stop_) {
+        realtime_executor_->spin_once(std::chrono::milliseconds(100));
     }
+}
 
-    std::string data;
-    if (!syn_msg.SerializeToString(&data)) {
-        std::cerr << "Failed to serialize Joy" << std::endl;
+LinkBridgeConfig SynapseRos::declare_link(const std::string& name, const std::string& prefix)
+{
+    // endpoint parameters, prefixed by the link name unless default link
+    std::string p = name.empty() ? "" : name + ".";
+    this->declare_parameter(p + "transport", "udp");
+    this->declare_parameter(p + "host", "192.0.2.1");
+    this->declare_parameter(p + "port", 4242);
+    // named links bind an ephemeral port unless set, a second link on the
+    // default port would fail to bind
+    this->declare_parameter(p + "local_port", name.empty() ? 4242 : 0);
+    this->declare_parameter(p + "device", "/dev/ttyUSB0");
+    this->declare_parameter(p + "baud", 921600);
+    this->declare_parameter(p + "record_path", "");
+    this->declare_parameter(p + "raw_topics", std::vector<int64_t> {});
+    this->declare_parameter(p + "raw_inject_topics", std::vector<int64_t> {});
+    this->declare_parameter(p + "reliable_topics", std::vector<int64_t> {});
+    this->declare_parameter(p + "codec_topics", std::vector<int64_t> {});
+    this->declare_parameter(p + "tx_high_topics", std::vector<int64_t> { SYNAPSE_JOY_TOPIC });
+    this->declare_parameter(p + "tx_low_topics", std::vector<int64_t> {});
+
+    LinkBridgeConfig config;
+    config.name = name.empty() ? "cerebri" : name;
+    config.prefix = prefix;
+    std::string transport = this->get_parameter(p + "transport").as_string();
+    if (!parse_link_transport(transport, config.link.transport)) {
+        RCLCPP_WARN(this->get_logger(), "unknown %stransport '%s', using udp", p.c_str(), transport.c_str());
+    }
+    config.link.host = this->get_parameter(p + "host").as_string();
+    config.link.port = this->get_parameter(p + "port").as_int();
+    config.link.local_port = this->get_parameter(p + "local_port").as_int();
+    config.link.resolve_retry_ms = this->get_parameter("resolve_retry_ms").as_int();
+    config.link.resolve_retry_max_ms = this->get_parameter("resolve_retry_max_ms").as_int();
+    config.link.device = this->get_parameter(p + "device").as_string();
+    config.link.baud = this->get_parameter(p + "baud").as_int();
+    config.link.tx_queue_depth = this->get_parameter("tx_queue_depth").as_int();
+    std::string tx_schedule = this->get_parameter("tx_schedule").as_string();
+    if (!parse_tx_schedule(tx_schedule, config.link.tx_schedule)) {
+        RCLCPP_WARN(this->get_logger(), "unknown tx_schedule '%s', using strict", tx_schedule.c_str());
     }
+    config.link.tx_weights = this->get_parameter("tx_weights").as_integer_array();
+    config.link.tx_class_inflight = this->get_parameter("tx_class_inflight").as_int();
+    config.link.tx_high_topics = this->get_parameter(p + "tx_high_topics").as_integer_array();
+    config.link.tx_low_topics = this->get_parameter(p + "tx_low_topics").as_integer_array();
+    config.link.tx_batch_window_us = this->get_parameter("tx_batch_window_us").as_int();
+    config.link.tx_batch_bytes = this->get_parameter("tx_batch_bytes").as_int();
+    config.link.rx_batch = this->get_parameter("rx_batch").as_int();
+    config.link.rx_buf_size = this->get_parameter("rx_buf_size").as_int();
+    config.link.rx_buffers = this->get_parameter("rx_buffers").as_int();
+    config.link.rx_workers = this->get_parameter("rx_workers").as_int();
+    config.link.rx_worker_queue_depth = this->get_parameter("rx_worker_queue_depth").as_int();
+    config.link.rcvbuf = this->get_parameter("socket_rcvbuf").as_int();
+    config.link.sndbuf = this->get_parameter("socket_sndbuf").as_int();
+    config.link.dscp = this->get_parameter("dscp").as_int();
+    config.link.so_priority = this->get_parameter("socket_priority").as_int();
+    config.link.low_latency = this->get_parameter("low_latency").as_bool();
+    config.link.busy_poll_us = this->get_parameter("busy_poll_us").as_int();
+    config.link.busy_poll_cpu = this->get_parameter("busy_poll_cpu").as_int();
+    config.link.record_path = this->get_parameter(p + "record_path").as_string();
+    config.link.record_size = this->get_parameter("record_size").as_int();
+    config.link.reliable_topics = this->get_parameter(p + "reliable_topics").as_integer_array();
+    config.link.reliable_timeout_ms = this->get_parameter("reliable_timeout_ms").as_int();
+    config.link.reliable_retries = this->get_parameter("reliable_retries").as_int();
+    config.link.codec_topics = this->get_parameter(p + "codec_topics").as_integer_array();
+    config.link.codec_control_topic = this->get_parameter("codec_control_topic").as_int();
+    config.link.codec_key_interval = this->get_parameter("codec_key_interval").as_int();
 
-    tf_send(SYNAPSE_JOY_TOPIC, data);
+    config.clock_sync = this->get_parameter("clock_sync").as_bool();
+    config.time_sync_period = this->get_parameter("time_sync_period").as_double();
+    config.joy_overflow_policy = parse_overflow_policy(this->get_logger(),
+        this->get_parameter("joy.overflow_policy").as_string());
+    config.road_curve_angle_overflow_policy = parse_overflow_policy(this->get_logger(),
+        this->get_parameter("road_curve_angle.overflow_policy").as_string());
+    config.raw_topics = this->get_parameter(p + "raw_topics").as_integer_array();
+    config.raw_inject_topics = this->get_parameter(p + "raw_inject_topics").as_integer_array();
+    config.raw_overflow_policy = parse_overflow_policy(this->get_logger(),
+        this->get_parameter("raw.overflow_policy").as_string());
+    config.qos = qos_;
+    config.lazy_publishers = this->get_parameter("lazy_publishers").as_bool();
+    config.realtime_topics = this->get_parameter("realtime_topics").as_string_array();
+    config.joy_throttle = get_throttle_config("joy");
+    config.road_curve_angle_throttle = get_throttle_config("road_curve_angle");
+    return config;
 }
 
-void SynapseRos::road_curve_angle_callback(const synapse_msgs::msg::RoadCurveAngle& msg) const
+void SynapseRos::declare_qos(const std::string& key, const TopicQosConfig& defaults)
 {
-    synapse::msgs::RoadCurveAngle syn_msg;
+    std::string p = "qos." + key + ".";
+    std::string reliability = this->declare_parameter(p + "reliability",
+        std::string(defaults.reliable ? "reliable" : "best_effort"));
+    int64_t depth = this->declare_parameter(p + "depth", (int64_t)defaults.depth);
+    std::string durability = this->declare_parameter(p + "durability",
+        std::string(defaults.transient_local ? "transient_local" : "volatile"));
+    double deadline_ms = this->declare_parameter(p + "deadline_ms", defaults.deadline_ms);
 
-    // header
-    syn_msg.mutable_header()->set_frame_id(msg.header.frame_id);
-    syn_msg.mutable_header()->mutable_stamp()->set_sec(msg.header.stamp.sec);
-    syn_msg.mutable_header()->mutable_stamp()->set_nanosec(msg.header.stamp.nanosec);
-
-    // vector
-    syn_msg.set_angle(msg.angle);
+    TopicQosConfig config = defaults;
+    if (reliability == "reliable" || reliability == "best_effort") {
+        config.reliable = reliability == "reliable";
+    } else {
+        RCLCPP_WARN(this->get_logger(), "unknown %sreliability '%s', using default", p.c_str(), reliability.c_str());
+    }
+    if (durability == "volatile" || durability == "transient_local") {
+        config.transient_local = durability == "transient_local";
+    } else {
+        RCLCPP_WARN(this->get_logger(), "unknown %sdurability '%s', using default", p.c_str(), durability.c_str());
+    }
+    config.depth = std::max<int64_t>(depth, 1);
+    config.deadline_ms = deadline_ms;
+    qos_[key] = config;
+}
 
-    std::string data;
-    if (!syn_msg.SerializeToString(&data)) {
-        std::cerr << "Failed to serialize RoadCurveAngle" << std::endl;
+TxThrottleConfig SynapseRos::get_throttle_config(const std::string& topic)
+{
+    TxThrottleConfig config;
+    config.max_rate = this->get_parameter(topic + ".max_rate").as_double();
+    config.coalesce = this->get_parameter(topic + ".coalesce").as_bool();
+    config.on_change = this->get_parameter(topic + ".on_change").as_bool();
+    if (config.coalesce && config.max_rate <= 0) {
+        RCLCPP_WARN(this->get_logger(), "%s.coalesce needs %s.max_rate > 0, ignored", topic.c_str(), topic.c_str());
+        config.coalesce = false;
     }
+    return config;
+}
 
-    tf_send(SYNAPSE_ROAD_CURVE_ANGLE_TOPIC, data);
+void SynapseRos::publish_diagnostics()
+{
+    diagnostic_msgs::msg::DiagnosticArray msg;
+    msg.header.stamp = this->now();
+    for (auto& link : links_) {
+        diagnostic_msgs::msg::DiagnosticStatus status;
+        status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        status.name = std::string(this->get_name()) + ": " + link->name() + " latency";
+        link->latency_diagnostics(status);
+        msg.status.push_back(status);
+    }
+    pub_diagnostics_->publish(msg);
 }
 
-void SynapseRos::tf_send(int topic, const std::string& data) const
+void SynapseRos::publish_link_stats()
 {
-    TF_Msg frame;
-    frame.type = topic;
-    frame.len = data.length();
-    frame.data = (const uint8_t*)data.c_str();
-    TF_Send(tf_.get(), &frame);
+    diagnostic_msgs::msg::DiagnosticArray msg;
+    msg.header.stamp = this->now();
+    for (auto& link : links_) {
+        diagnostic_msgs::msg::DiagnosticStatus status;
+        status.hardware_id = link->name();
+        status.name = std::string(this->get_name()) + ": " + link->name() + " link";
+        link->link_diagnostics(status);
+        msg.status.push_back(status);
+
+        diagnostic_msgs::msg::DiagnosticStatus unknown;
+        unknown.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+        unknown.name = std::string(this->get_name()) + ": " + link->name() + " unhandled frames";
+        link->unknown_frame_diagnostics(unknown);
+        if (!unknown.values.empty()) {
+            unknown.level = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+            unknown.message = "cerebri sends topics that are not bridged";
+        }
+        msg.status.push_back(unknown);
+    }
+    pub_diagnostics_->publish(msg);
 }
 
-int main(int argc, char** argv)
+void SynapseRos::io_entry_point(int index)
 {
-    rclcpp::init(argc, argv);
-    rclcpp::spin(std::make_shared<SynapseRos>());
-    rclcpp::shutdown();
-    return 0;
+    if (index < (int)io_cpus_.size() && !pin_current_thread(io_cpus_[index])) {
+        RCLCPP_WARN(this->get_logger(), "failed to pin io thread %d to cpu %ld", index, io_cpus_[index]);
+    }
+    if (io_priority_ > 0 && !set_current_thread_fifo(io_priority_)) {
+        RCLCPP_WARN(this->get_logger(), "failed to set SCHED_FIFO priority %d on io thread %d", io_priority_, index);
+    }
+
+    // runs until io_stop(), the work guard keeps it alive while idle
+    io_context_.run();
 }
 
+RCLCPP_COMPONENTS_REGISTER_NODE(SynapseRos)
+
 // vi: ts=4 sw=4 et
@@ -1,60 +1,60 @@
 #ifndef SYNAPSE_ROS_CLIENT_HPP__
 #define SYNAPSE_ROS_CLIENT_HPP__
 
-#include <actuator_msgs/msg/actuators.hpp>
-#include <builtin_interfaces/msg/time.hpp>
-#include <geometry_msgs/msg/twist.hpp>
-
 #include <rclcpp/rclcpp.hpp>
-#include <rclcpp/subscription_options.hpp>
-
-#include <sensor_msgs/msg/joy.hpp>
-#include <synapse_protobuf/joy.pb.h>
-
-#include <synapse_msgs/msg/status.hpp>
-#include <synapse_protobuf/status.pb.h>
 
-#include <synapse_msgs/msg/road_curve_angle.hpp>
-#include <synapse_protobuf/road_curve_angle.pb.h>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 
-#include <synapse_tinyframe/SynapseTopics.h>
-#include <synapse_tinyframe/TinyFrame.h>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
 
-class UdpClient;
-
-void udp_entry_point();
+#include "link_bridge.hpp"
 
+// Bridge node. Manages one LinkBridge per cerebri board listed in the
+// "links" parameter (or a single default link from host/port), all served
+// by one io_context and a shared pool of io threads.
 class SynapseRos : public rclcpp::Node {
 public:
-    SynapseRos();
+    explicit SynapseRos(const rclcpp::NodeOptions& options = rclcpp::NodeOptions());
     virtual ~SynapseRos();
 
-    void tf_send(int topic, const std::string& data) const;
-
-    void publish_status(const synapse::msgs::Status& msg);
-    void publish_uptime(const synapse::msgs::Time& msg);
-
 private:
-    std::shared_ptr<TinyFrame> tf_ {};
-    builtin_interfaces::msg::Time ros_clock_offset_ {};
-
-    std_msgs::msg::Header compute_header(const synapse::msgs::Header& msg);
-
-    // subscriptions ros -> cerebri
-    rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr sub_joy_;
-    rclcpp::Subscription<synapse_msgs::msg::RoadCurveAngle>::SharedPtr sub_road_curve_angle_;
-
-    // subscription callbacks
-    void joy_callback(const sensor_msgs::msg::Joy& msg) const;
-    void road_curve_angle_callback(const synapse_msgs::msg::RoadCurveAngle& msg) const;
-
-    // publications cerebri -> ros
-    rclcpp::Publisher<synapse_msgs::msg::Status>::SharedPtr pub_status_;
-    rclcpp::Publisher<builtin_interfaces::msg::Time>::SharedPtr pub_uptime_;
-    rclcpp::Publisher<builtin_interfaces::msg::Time>::SharedPtr pub_clock_offset_;
-
-    // callbacks
-    std::shared_ptr<std::thread> udp_thread_;
+    LinkBridgeConfig declare_link(const std::string& name, const std::string& prefix);
+    TxThrottleConfig get_throttle_config(const std::string& topic);
+    void declare_qos(const std::string& key, const TopicQosConfig& defaults);
+    std::map<std::string, TopicQosConfig> qos_ {};
+
+    boost::asio::io_context io_context_ {};
+    std::vector<std::shared_ptr<LinkBridge>> links_ {};
+
+    // periodic statistics export
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr pub_diagnostics_;
+    rclcpp::TimerBase::SharedPtr diagnostics_timer_;
+    void publish_diagnostics();
+    rclcpp::TimerBase::SharedPtr stats_timer_;
+    void publish_link_stats();
+
+    // io thread pool, optionally pinned to io_cpus and run SCHED_FIFO
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> io_work_ {
+        boost::asio::make_work_guard(io_context_)
+    };
+    std::vector<std::thread> io_threads_ {};
+    std::vector<int64_t> io_cpus_ {};
+    int io_priority_ { 0 };
+    rclcpp::OnShutdownCallbackHandle shutdown_handle_ {};
+    void io_entry_point(int index);
+    void io_stop();
+
+    // the callback groups of the realtime topics of all links are spun by
+    // this executor on a dedicated thread, optionally pinned and SCHED_FIFO,
+    // so bulk topics on the node's executor cannot hold them up
+    std::unique_ptr<rclcpp::executors::SingleThreadedExecutor> realtime_executor_ {};
+    std::thread realtime_thread_ {};
+    std::atomic<bool> realtime_stop_ { false };
+    int realtime_cpu_ { -1 };
+    int realtime_priority_ { 0 };
+    void realtime_entry_point();
+    void realtime_stop();
 };
 
 // vi: ts=4 sw=4 et
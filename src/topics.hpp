@@ -0,0 +1,71 @@
+#ifndef SYNAPSE_ROS_TOPICS_HPP__
+#define SYNAPSE_ROS_TOPICS_HPP__
+
+#include <array>
+#include <cstddef>
+
+#include <synapse_tinyframe/SynapseTopics.h>
+
+#include "converters.hpp"
+#include "proto/latency.hpp"
+
+// Compile time registry of bridged topics.
+//
+// Each inbound entry ties a SYNAPSE_*_TOPIC id to the protobuf type decoded
+// from the frame, the ROS type published and the converter between them,
+// key names the topic in per topic parameters (qos.<key>.*).
+// LinkBridge expands InboundTopics into a flat handler table indexed by
+// topic id, so adding a topic is one struct and one list entry here.
+
+template <typename... Topics>
+struct TopicList { };
+
+struct StatusTopic {
+    static constexpr int id = SYNAPSE_STATUS_TOPIC;
+    static constexpr const char* name = "out/status";
+    static constexpr const char* key = "status";
+    using proto_type = synapse::msgs::Status;
+    using ros_type = synapse_msgs::msg::Status;
+    static void convert(const proto_type& msg, ros_type& ros_msg, const ConvertContext& ctx)
+    {
+        status_to_ros(msg, ros_msg, ctx);
+    }
+};
+
+// also feeds the link's clock estimate, see LinkBridge::uptime_received
+struct UptimeTopic {
+    static constexpr int id = SYNAPSE_UPTIME_TOPIC;
+    static constexpr const char* name = "out/uptime";
+    static constexpr const char* key = "uptime";
+    using proto_type = synapse::msgs::Time;
+    using ros_type = builtin_interfaces::msg::Time;
+    static void convert(const proto_type& msg, ros_type& ros_msg, const ConvertContext& ctx)
+    {
+        uptime_to_ros(msg, ros_msg, ctx);
+    }
+};
+
+using InboundTopics = TopicList<StatusTopic, UptimeTopic>;
+
+template <typename... Topics>
+constexpr bool topic_ids_valid(TopicList<Topics...>)
+{
+    std::array<int, sizeof...(Topics)> ids { Topics::id... };
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] < 0 || ids[i] >= (int)topic_count) {
+            return false;
+        }
+        for (std::size_t j = i + 1; j < ids.size(); ++j) {
+            if (ids[i] == ids[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(topic_ids_valid(InboundTopics {}), "inbound topic ids must be unique and below topic_count");
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_TOPICS_HPP__
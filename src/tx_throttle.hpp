@@ -0,0 +1,122 @@
+#ifndef SYNAPSE_ROS_TX_THROTTLE_HPP__
+#define SYNAPSE_ROS_TX_THROTTLE_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+#include <sensor_msgs/msg/joy.hpp>
+#include <synapse_msgs/msg/road_curve_angle.hpp>
+
+// Subscription side traffic shaping for ROS -> cerebri topics.
+//
+//  max_rate   forward at most this many messages per second, 0 unlimited
+//  coalesce   latest value wins, the newest message is forwarded once per
+//             1 / max_rate tick instead of dropping what arrives in between
+//  on_change  skip messages whose content equals the last forwarded one
+//
+// Note that on_change stops forwarding while the input holds still, so
+// cerebri side timeouts (e.g. the joystick failsafe) must not rely on a
+// steady stream from a topic with on_change set.
+
+struct TxThrottleConfig {
+    double max_rate { 0 };
+    bool coalesce { false };
+    bool on_change { false };
+};
+
+// content comparison for on_change, stamps are ignored since they differ
+// on every message
+inline bool same_content(const sensor_msgs::msg::Joy& a, const sensor_msgs::msg::Joy& b)
+{
+    return a.axes == b.axes && a.buttons == b.buttons;
+}
+
+inline bool same_content(const synapse_msgs::msg::RoadCurveAngle& a, const synapse_msgs::msg::RoadCurveAngle& b)
+{
+    return a.angle == b.angle && a.header.frame_id == b.header.frame_id;
+}
+
+// Not thread safe, admit() and tick() run in the subscription's callback
+// group, only suppressed() may be read from anywhere. Copies of the
+// message reuse their storage after the first one.
+template <typename T>
+class TxThrottle {
+public:
+    explicit TxThrottle(const TxThrottleConfig& config)
+        : config_(config)
+        , period_ns_(config.max_rate > 0 ? (int64_t)(1e9 / config.max_rate) : 0)
+    {
+    }
+
+    // true if the coalescing tick has to run, at max_rate
+    bool coalescing() const { return config_.coalesce && period_ns_ > 0; }
+    int64_t period_ns() const { return period_ns_; }
+
+    // true if msg should be forwarded right away, otherwise it was either
+    // suppressed or kept for the next tick
+    bool admit(const T& msg, int64_t now_ns)
+    {
+        if (coalescing()) {
+            if (has_pending_) {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+            }
+            pending_ = msg;
+            has_pending_ = true;
+            return false;
+        }
+        if (config_.on_change && has_last_ && same_content(msg, last_)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (period_ns_ > 0 && has_sent_ && now_ns - last_sent_ns_ < period_ns_) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        has_sent_ = true;
+        last_sent_ns_ = now_ns;
+        remember(msg);
+        return true;
+    }
+
+    // coalescing tick, the message to forward or nullptr
+    const T* tick()
+    {
+        if (!has_pending_) {
+            return nullptr;
+        }
+        has_pending_ = false;
+        if (config_.on_change && has_last_ && same_content(pending_, last_)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        remember(pending_);
+        return &pending_;
+    }
+
+    // messages not forwarded because of the policy
+    uint64_t suppressed() const { return suppressed_.load(std::memory_order_relaxed); }
+
+private:
+    void remember(const T& msg)
+    {
+        if (config_.on_change) {
+            last_ = msg;
+            has_last_ = true;
+        }
+    }
+
+    TxThrottleConfig config_;
+    int64_t period_ns_;
+
+    T pending_ {};
+    bool has_pending_ { false };
+    T last_ {};
+    bool has_last_ { false };
+    int64_t last_sent_ns_ { 0 };
+    bool has_sent_ { false };
+    std::atomic<uint64_t> suppressed_ { 0 };
+};
+
+// vi: ts=4 sw=4 et
+
+#endif // SYNAPSE_ROS_TX_THROTTLE_HPP__
@@ -0,0 +1,131 @@
+// ClockSync and the stamp helpers: the nanosecond carry around second
+// boundaries, drift scaling far from the anchor and the window picking its
+// minimum sample as the new anchor.
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "../src/clock_sync.hpp"
+
+static constexpr int64_t ms = 1000000;
+
+static void expect_stamp(int64_t ns, int32_t sec, uint32_t nanosec)
+{
+    builtin_interfaces::msg::Time stamp;
+    ns_to_stamp(ns, stamp);
+    EXPECT_EQ(stamp.sec, sec) << "ns " << ns;
+    EXPECT_EQ(stamp.nanosec, nanosec) << "ns " << ns;
+    EXPECT_EQ(stamp_to_ns(stamp.sec, stamp.nanosec), ns);
+}
+
+TEST(StampConversion, SecondBoundaries)
+{
+    expect_stamp(0, 0, 0);
+    expect_stamp(1, 0, 1);
+    expect_stamp(ns_per_sec - 1, 0, 999999999);
+    expect_stamp(ns_per_sec, 1, 0);
+    expect_stamp(ns_per_sec + 1, 1, 1);
+    expect_stamp(5 * ns_per_sec, 5, 0);
+}
+
+TEST(StampConversion, NegativeNanoseconds)
+{
+    expect_stamp(-1, -1, 999999999);
+    expect_stamp(-ns_per_sec + 1, -1, 1);
+    expect_stamp(-ns_per_sec, -1, 0);
+    expect_stamp(-ns_per_sec - 1, -2, 999999999);
+    expect_stamp(-5 * ns_per_sec, -5, 0);
+}
+
+TEST(ClockSync, IdentityWithoutSamples)
+{
+    ClockSync clock;
+    EXPECT_EQ(clock.to_local(123456789), 123456789);
+    EXPECT_EQ(clock.estimate().samples, 0u);
+}
+
+// one way samples: the window keeps the smallest offset, the sample with
+// the least delay, and makes it the anchor once the window is full
+TEST(ClockSync, OneWayWindowKeepsMinimumOffset)
+{
+    ClockSync clock;
+    constexpr int64_t base = 1000 * ns_per_sec;
+    auto delay = [](uint32_t i) { return i == 9 ? 1 * ms : (int64_t)(5 + i % 3) * ms; };
+
+    for (uint32_t i = 0; i < ClockSync::window_size; ++i) {
+        int64_t remote = (int64_t)i * 10 * ms;
+        clock.add_sample(remote, base + remote + delay(i));
+        if (i + 1 < ClockSync::window_size) {
+            // the first sample anchors the estimate until the window is full
+            EXPECT_EQ(clock.estimate().offset_ns, base + delay(0));
+        }
+    }
+    ClockSync::Estimate e = clock.estimate();
+    EXPECT_EQ(e.ref_ns, 9 * 10 * ms);
+    EXPECT_EQ(e.offset_ns, base + 1 * ms);
+    EXPECT_EQ(e.rtt_ns, 0);
+    EXPECT_EQ(e.samples, ClockSync::window_size);
+}
+
+// round trips: the window keeps the sample with the smallest round trip
+// time, its offset is taken at the midpoint of send and receive
+TEST(ClockSync, RoundTripWindowKeepsMinimumRtt)
+{
+    ClockSync clock;
+    constexpr int64_t base = 50 * ns_per_sec;
+    auto rtt = [](uint32_t i) { return i == 11 ? 2 * ms : (int64_t)(10 + i % 4) * ms; };
+
+    for (uint32_t i = 0; i < ClockSync::window_size; ++i) {
+        int64_t remote = (int64_t)i * 100 * ms;
+        int64_t send = base + remote - rtt(i) / 2;
+        clock.add_round_trip(remote, send, send + rtt(i));
+    }
+    ClockSync::Estimate e = clock.estimate();
+    EXPECT_EQ(e.ref_ns, 11 * 100 * ms);
+    EXPECT_EQ(e.rtt_ns, 2 * ms);
+    EXPECT_EQ(e.offset_ns, base);
+
+    // once round trips arrive one way samples are ignored
+    clock.add_sample(2 * ns_per_sec, 0);
+    EXPECT_EQ(clock.estimate().samples, e.samples);
+}
+
+TEST(ClockSync, StepRestartsEstimate)
+{
+    ClockSync clock;
+    for (uint32_t i = 0; i < 4; ++i) {
+        clock.add_sample((int64_t)i * 10 * ms, ns_per_sec + (int64_t)i * 10 * ms);
+    }
+    // cerebri rebooted, its uptime starts over
+    clock.add_sample(0, 100 * ns_per_sec);
+    ClockSync::Estimate e = clock.estimate();
+    EXPECT_EQ(e.samples, 1u);
+    EXPECT_EQ(e.offset_ns, 100 * ns_per_sec);
+}
+
+// the remote clock runs 100 ppm slow, the offset grows 100 us per second.
+// After two windows the drift is the smoothed slope between their anchors,
+// and translating a time far from the anchor must not overflow dt * ppb.
+TEST(ClockSync, DriftScalesOverLargeDt)
+{
+    ClockSync clock;
+    constexpr int64_t base = 10 * ns_per_sec;
+    constexpr int64_t period = 10 * ms;
+    for (uint32_t i = 0; i < 2 * ClockSync::window_size + 1; ++i) {
+        int64_t remote = (int64_t)i * period;
+        clock.add_sample(remote, base + remote + remote / 10000);
+    }
+    ClockSync::Estimate e = clock.estimate();
+    // first window: no slope yet, second: (3 * 0 + 100000) / 4
+    EXPECT_NEAR(e.drift_ppb, 25000, 1);
+
+    // 1e6 s away dt * ppb is 2.5e19, beyond int64
+    for (int64_t dt : { 1000000 * ns_per_sec, -1000000 * ns_per_sec, 3 * ns_per_sec + 7 }) {
+        int64_t remote = e.ref_ns + dt;
+        long double expected = (long double)remote + e.offset_ns + (long double)dt * e.drift_ppb / ns_per_sec;
+        EXPECT_NEAR((long double)clock.to_local(remote), expected, 1.0L) << "dt " << dt;
+    }
+}
+
+// vi: ts=4 sw=4 et
@@ -0,0 +1,74 @@
+// The encoders run on the subscription callbacks of every outbound message,
+// once warmed up by the first message of a shape they must not allocate.
+// Allocations are counted by the global operator new replaced below.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <gtest/gtest.h>
+
+#include "../src/encoders.hpp"
+
+static std::atomic<uint64_t> allocations { 0 };
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static constexpr int iterations = 1000;
+
+TEST(EncoderAllocations, Joy)
+{
+    sensor_msgs::msg::Joy msg;
+    msg.axes.assign(8, 0.25f);
+    msg.buttons.assign(12, 1);
+    JoyEncoder encoder;
+    uint8_t buf[1024];
+    ASSERT_GT(encoder.encode(msg, buf, sizeof(buf)), 0);
+
+    uint64_t start = allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < iterations; ++i) {
+        msg.axes[i % msg.axes.size()] = i * 0.001f;
+        msg.buttons[i % msg.buttons.size()] = i & 1;
+        ASSERT_GT(encoder.encode(msg, buf, sizeof(buf)), 0);
+    }
+    EXPECT_EQ(allocations.load(std::memory_order_relaxed) - start, 0u);
+}
+
+TEST(EncoderAllocations, RoadCurveAngle)
+{
+    synapse_msgs::msg::RoadCurveAngle msg;
+    msg.header.frame_id = "base_link";
+    msg.header.stamp.sec = 1700000000;
+    msg.header.stamp.nanosec = 123456789;
+    msg.angle = 0.1;
+    RoadCurveAngleEncoder encoder;
+    uint8_t buf[1024];
+    ASSERT_GT(encoder.encode(msg, buf, sizeof(buf)), 0);
+
+    uint64_t start = allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < iterations; ++i) {
+        msg.header.stamp.nanosec = i;
+        msg.angle = i * 0.001;
+        ASSERT_GT(encoder.encode(msg, buf, sizeof(buf)), 0);
+    }
+    EXPECT_EQ(allocations.load(std::memory_order_relaxed) - start, 0u);
+}
+
+// vi: ts=4 sw=4 et
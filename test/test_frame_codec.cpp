@@ -0,0 +1,210 @@
+// FrameCodec round trips: keys, deltas against the last key, lost keys,
+// malformed deltas and payloads that change length.
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/proto/frame_codec.hpp"
+
+static constexpr int topic = 7;
+
+class FrameCodecTest : public ::testing::Test {
+protected:
+    FrameCodecTest()
+        : tx_(250, { topic }, 4)
+        , rx_(250, { topic }, 4)
+    {
+    }
+
+    // encode payload on tx_, the encoded frame
+    std::vector<uint8_t> encode(const std::vector<uint8_t>& payload, bool key_only = false)
+    {
+        std::vector<uint8_t> out(payload.size() + FrameCodec::header_length);
+        out.resize(tx_.encode(topic, payload.data(), payload.size(), out.data(), key_only));
+        return out;
+    }
+
+    // decode frame on rx_, -1 or the decoded length, the payload in decoded_
+    int decode(const std::vector<uint8_t>& frame)
+    {
+        int len = rx_.decode(topic, frame.data(), frame.size(), decoded_.data(), decoded_.size());
+        if (len >= 0) {
+            result_.assign(decoded_.begin(), decoded_.begin() + len);
+        }
+        return len;
+    }
+
+    static std::vector<uint8_t> payload(std::size_t len, uint8_t seed)
+    {
+        std::vector<uint8_t> p(len);
+        for (std::size_t i = 0; i < len; ++i) {
+            p[i] = (uint8_t)(i * 31 + seed);
+        }
+        return p;
+    }
+
+    FrameCodec tx_;
+    FrameCodec rx_;
+    std::vector<uint8_t> decoded_ = std::vector<uint8_t>(4096);
+    std::vector<uint8_t> result_ {};
+};
+
+TEST_F(FrameCodecTest, KeyThenDelta)
+{
+    std::vector<uint8_t> p = payload(200, 1);
+    std::vector<uint8_t> key = encode(p);
+    ASSERT_EQ(key[0], FrameCodec::Key);
+    ASSERT_EQ(decode(key), (int)p.size());
+    EXPECT_EQ(result_, p);
+
+    // a few changed bytes make a delta much smaller than the payload
+    p[10] ^= 0x55;
+    p[150] ^= 0x01;
+    std::vector<uint8_t> delta = encode(p);
+    ASSERT_EQ(delta[0], FrameCodec::Delta);
+    EXPECT_LT(delta.size(), p.size() / 4);
+    ASSERT_EQ(decode(delta), (int)p.size());
+    EXPECT_EQ(result_, p);
+
+    // an unchanged payload still decodes to itself
+    delta = encode(p);
+    ASSERT_EQ(delta[0], FrameCodec::Delta);
+    ASSERT_EQ(decode(delta), (int)p.size());
+    EXPECT_EQ(result_, p);
+}
+
+TEST_F(FrameCodecTest, KeyInterval)
+{
+    std::vector<uint8_t> p = payload(64, 2);
+    std::vector<uint8_t> modes;
+    for (int i = 0; i < 8; ++i) {
+        std::vector<uint8_t> frame = encode(p);
+        modes.push_back(frame[0]);
+        ASSERT_EQ(decode(frame), (int)p.size());
+        EXPECT_EQ(result_, p);
+    }
+    std::vector<uint8_t> expected { FrameCodec::Key, FrameCodec::Delta, FrameCodec::Delta, FrameCodec::Delta,
+        FrameCodec::Key, FrameCodec::Delta, FrameCodec::Delta, FrameCodec::Delta };
+    EXPECT_EQ(modes, expected);
+
+    // reliable frames never depend on a reference
+    EXPECT_EQ(encode(p, true)[0], FrameCodec::Key);
+}
+
+TEST_F(FrameCodecTest, LostKey)
+{
+    std::vector<uint8_t> p = payload(100, 3);
+    ASSERT_EQ(decode(encode(p)), (int)p.size());
+
+    // the next key is lost, the deltas referring to it cannot be decoded
+    for (int i = 0; i < 3; ++i) {
+        encode(p);
+    }
+    p[0] ^= 0xff;
+    std::vector<uint8_t> lost = encode(p);
+    ASSERT_EQ(lost[0], FrameCodec::Key);
+    p[1] ^= 0xff;
+    std::vector<uint8_t> delta = encode(p);
+    ASSERT_EQ(delta[0], FrameCodec::Delta);
+    EXPECT_EQ(decode(delta), -1);
+
+    // until the key after it arrives
+    for (int i = 0; i < 2; ++i) {
+        encode(p);
+    }
+    std::vector<uint8_t> key = encode(p);
+    ASSERT_EQ(key[0], FrameCodec::Key);
+    ASSERT_EQ(decode(key), (int)p.size());
+    EXPECT_EQ(result_, p);
+}
+
+TEST_F(FrameCodecTest, DeltaWithoutKey)
+{
+    std::vector<uint8_t> p = payload(100, 4);
+    encode(p);
+    std::vector<uint8_t> delta = encode(p);
+    ASSERT_EQ(delta[0], FrameCodec::Delta);
+    EXPECT_EQ(decode(delta), -1);
+}
+
+TEST_F(FrameCodecTest, MalformedDelta)
+{
+    std::vector<uint8_t> p = payload(100, 5);
+    ASSERT_EQ(decode(encode(p)), (int)p.size());
+    p[50] ^= 0x10;
+    std::vector<uint8_t> delta = encode(p);
+    ASSERT_EQ(delta[0], FrameCodec::Delta);
+
+    // every truncation of the delta is rejected
+    for (std::size_t len = 0; len < delta.size(); ++len) {
+        std::vector<uint8_t> cut(delta.begin(), delta.begin() + len);
+        EXPECT_EQ(decode(cut), -1) << "len " << len;
+    }
+
+    // trailing bytes, an unknown mode and a length beyond the buffer
+    std::vector<uint8_t> longer = delta;
+    longer.push_back(0);
+    EXPECT_EQ(decode(longer), -1);
+    std::vector<uint8_t> mode = delta;
+    mode[0] = 7;
+    EXPECT_EQ(decode(mode), -1);
+    std::vector<uint8_t> huge { FrameCodec::Delta, delta[1], 0xff, 0xff, 0xff, 0x7f };
+    EXPECT_EQ(decode(huge), -1);
+
+    // garbage never crashes and the reference survives it
+    for (int seed = 0; seed < 256; ++seed) {
+        std::vector<uint8_t> garbage = payload(1 + seed % 40, seed);
+        garbage[0] = FrameCodec::Delta;
+        decode(garbage);
+    }
+    ASSERT_EQ(decode(delta), (int)p.size());
+    EXPECT_EQ(result_, p);
+}
+
+TEST_F(FrameCodecTest, LengthChange)
+{
+    std::vector<uint8_t> p = payload(100, 6);
+    ASSERT_EQ(decode(encode(p)), (int)p.size());
+
+    // longer than the reference, the tail is XORed against zeros
+    std::vector<uint8_t> longer = p;
+    longer.insert(longer.end(), { 1, 2, 3, 0, 0, 4 });
+    std::vector<uint8_t> frame = encode(longer);
+    ASSERT_EQ(frame[0], FrameCodec::Delta);
+    ASSERT_EQ(decode(frame), (int)longer.size());
+    EXPECT_EQ(result_, longer);
+
+    // shorter than the reference
+    std::vector<uint8_t> shorter(p.begin(), p.begin() + 40);
+    frame = encode(shorter);
+    ASSERT_EQ(frame[0], FrameCodec::Delta);
+    ASSERT_EQ(decode(frame), (int)shorter.size());
+    EXPECT_EQ(result_, shorter);
+}
+
+TEST_F(FrameCodecTest, AcceptLapse)
+{
+    uint8_t offer[16];
+    uint32_t len = tx_.offer(offer, sizeof(offer));
+    ASSERT_EQ(len, 2u);
+
+    EXPECT_FALSE(tx_.active(topic, 0));
+    ASSERT_TRUE(tx_.accept(offer, len, 0));
+    EXPECT_TRUE(tx_.active(topic, 0));
+    EXPECT_FALSE(tx_.active(topic + 1, 0));
+    EXPECT_FALSE(tx_.active(topic, FrameCodec::accept_lifetime_ns));
+
+    uint8_t other_version[] = { FrameCodec::version + 1, topic };
+    EXPECT_FALSE(tx_.accept(other_version, sizeof(other_version), 0));
+
+    // a lapsed codec starts afresh, the first frame is a key again
+    std::vector<uint8_t> p = payload(32, 7);
+    encode(p);
+    ASSERT_EQ(encode(p)[0], FrameCodec::Delta);
+    ASSERT_TRUE(tx_.accept(offer, len, 2 * FrameCodec::accept_lifetime_ns));
+    EXPECT_EQ(encode(p)[0], FrameCodec::Key);
+}
+
+// vi: ts=4 sw=4 et